@@ -0,0 +1,34 @@
+ifndef VERBOSE
+.SILENT:
+endif
+
+.DEFAULT_GOAL := all
+
+include common.mk
+
+TARGET=bench/$(BENCH)
+
+BENCH_OBJ = $(BUILD_DIR)/bench_obj
+
+OUTPUTS := $(BENCH_OBJ)/$(BENCH)
+
+CREATE_MAP := no
+
+all: elf
+
+VPATH += $(COMMON_VPATH)
+
+include $(TMK_PATH)/common.mk
+include $(QUANTUM_PATH)/serial_link/tests/rules.mk
+include $(TMK_PATH)/common/tests/rules.mk
+
+$(BENCH_OBJ)/$(BENCH)_SRC := $($(BENCH)_SRC)
+$(BENCH_OBJ)/$(BENCH)_INC := $($(BENCH)_INC) $(VPATH)
+$(BENCH_OBJ)/$(BENCH)_DEFS := $($(BENCH)_DEFS)
+
+include $(TMK_PATH)/native.mk
+include $(TMK_PATH)/rules.mk
+
+
+$(shell mkdir -p $(BUILD_DIR)/bench 2>/dev/null)
+$(shell mkdir -p $(BENCH_OBJ) 2>/dev/null)
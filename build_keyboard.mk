@@ -190,6 +190,11 @@ ifeq ($(strip $(RGBLIGHT_ENABLE)), yes)
 	SRC += $(QUANTUM_DIR)/rgblight.c
 endif
 
+ifeq ($(strip $(RGBLIGHT_REACTIVE_ENABLE)), yes)
+	OPT_DEFS += -DRGBLIGHT_REACTIVE_ENABLE
+	SRC += $(QUANTUM_DIR)/rgblight_reactive.c
+endif
+
 ifeq ($(strip $(TAP_DANCE_ENABLE)), yes)
 	OPT_DEFS += -DTAP_DANCE_ENABLE
 	SRC += $(QUANTUM_DIR)/process_keycode/process_tap_dance.c
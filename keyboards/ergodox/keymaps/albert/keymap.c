@@ -516,14 +516,12 @@ const macro_t *action_get_macro(keyrecord_t *record, uint8_t id, uint8_t opt)
         break;
     case 25:
         if (record->event.pressed) {
-            SEND_STRING("continue");
-            return MACRO(T(SCLN), END);
+            SEND_STRING("continue;");
         }
         break;
     case 26:
         if (record->event.pressed) {
-            SEND_STRING("break");
-            return MACRO(T(SCLN), END);
+            SEND_STRING("break;");
         }
         break;
     case 27:
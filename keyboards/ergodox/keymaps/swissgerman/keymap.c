@@ -268,6 +268,8 @@ void matrix_scan_user(void) {
 };
 
 void send_key(uint16_t keycode) {
+  // SEND_STRING only queues, let it catch up first
+  send_string_flush();
   register_code(keycode);
   unregister_code(keycode);
 }
@@ -281,6 +283,7 @@ void go_back_based_on_tag(char* tag) {
 }
 
 void send_larger_than() {
+  send_string_flush();
   register_code(KC_LSFT);
   send_key(KC_NONUS_BSLASH);
   unregister_code(KC_LSFT);
@@ -5,10 +5,11 @@
 #include "action_layer.h"
 
 #ifndef DYNAMIC_MACRO_SIZE
-/* May be overridden with a custom value. Be aware that the effective
- * macro length is half of this value: each keypress is recorded twice
- * because of the down-event and up-event. This is not a bug, it's the
- * intended behavior.
+/* May be overridden with a custom value. The buffer takes as much RAM
+ * as DYNAMIC_MACRO_SIZE keyrecord_t entries would, but the events are
+ * stored packed (see below) so it holds several times as many
+ * keypresses. Each keypress is recorded twice because of the down-event
+ * and up-event. This is not a bug, it's the intended behavior.
  *
  * Usually it should be fine to set the macro size to at least 256 but
  * there have been reports of it being too much in some users' cases,
@@ -17,6 +18,19 @@
 #define DYNAMIC_MACRO_SIZE 128
 #endif
 
+#define DYNAMIC_MACRO_BYTES (DYNAMIC_MACRO_SIZE * sizeof(keyrecord_t))
+
+#if MATRIX_ROWS * MATRIX_COLS > 256
+#error "dynamic macros store the key position in one byte"
+#endif
+
+/* Playback speed in percent of the recorded speed. 0 replays the
+ * macro as fast as the main loop allows.
+ */
+#ifndef DYNAMIC_MACRO_SPEED
+#define DYNAMIC_MACRO_SPEED 100
+#endif
+
 /* DYNAMIC_MACRO_RANGE must be set as the last element of user's
  * "planck_keycodes" enum prior to including this header. This allows
  * us to 'extend' it.
@@ -28,6 +42,243 @@ enum dynamic_macro_keycodes {
     DYN_MACRO_PLAY2,
 };
 
+/* Every event is stored as
+ *
+ *   key      - row * MATRIX_COLS + col
+ *   flags    - bit 7 pressed, bit 6 tap state follows, bit 5 more delta
+ *              bytes follow, bits 4..0 lowest delta bits
+ *   [delta]  - further 7 bit groups of the delay since the previous
+ *              event in ms, bit 7 set when another group follows
+ *   [tap]    - the raw tap_t, only for events with tap state
+ *
+ * which is 2 bytes for most events instead of a whole keyrecord_t.
+ */
+#define DM_PRESSED   0x80
+#define DM_TAP       0x40
+#define DM_MORE      0x20
+#define DM_DELTA     0x1F
+#define DM_EVENT_MAX 6
+
+/* Both macros use the same buffer but read/write on different
+ * ends of it.
+ *
+ * Macro1 is written left-to-right starting from the beginning of
+ * the buffer.
+ *
+ * Macro2 is written right-to-left starting from the end of the
+ * buffer.
+ *
+ * &macro_buffer   macro_end
+ *  v                   v
+ * +------------------------------------------------------------+
+ * |>>>>>> MACRO1 >>>>>>|    |<<<<<<<<<<<<< MACRO2 <<<<<<<<<<<<<|
+ * +------------------------------------------------------------+
+ *                           ^                                 ^
+ *                         r_macro_end                  r_macro_buffer
+ *
+ * During the recording when one macro encounters the end of the
+ * other macro, the recording is stopped. Apart from this, there
+ * are no arbitrary limits for the macros' length in relation to
+ * each other: for example one can either have two medium sized
+ * macros or one long macro and one short macro. Or even one empty
+ * and one using the whole buffer.
+ *
+ * Macro2 is stored back to front, so both macros are read and written
+ * the same way, just in a different direction.
+ */
+static uint8_t macro_buffer[DYNAMIC_MACRO_BYTES];
+
+/* Pointer to the first buffer element after the first macro.
+ * Initially points to the very beginning of the buffer since the
+ * macro is empty. */
+static uint8_t *macro_end = macro_buffer;
+
+/* The other end of the macro buffer. Serves as the beginning of
+ * the second macro. */
+static uint8_t *const r_macro_buffer = macro_buffer + DYNAMIC_MACRO_BYTES - 1;
+
+/* Like macro_end but for the second macro. */
+static uint8_t *r_macro_end = macro_buffer + DYNAMIC_MACRO_BYTES - 1;
+
+/* Timestamp of the last recorded event, 0 before the first one. */
+static uint16_t dynamic_macro_record_time;
+
+/* Playback state, advanced by dynamic_macro_task(). */
+static struct {
+    uint8_t *pointer;
+    uint8_t *end;
+    int8_t direction;
+    bool playing;
+    uint16_t timer;
+    uint16_t delay;
+    keyrecord_t record;
+    uint32_t saved_layer_state;
+} dynamic_macro_player;
+
+static uint8_t dynamic_macro_speed = DYNAMIC_MACRO_SPEED;
+
+/* 0   - no macro is being recorded right now
+ * 1,2 - either macro 1 or 2 is being recorded */
+static uint8_t macro_id = 0;
+
+#ifdef DYNAMIC_MACRO_EEPROM
+/* Keep both macros across power cycles. The EEPROM region after the
+ * eeconfig block holds a header followed by a copy of macro_buffer:
+ *
+ *   magic(2) size(2) macro_end(2) r_macro_end(2) buffer[DYNAMIC_MACRO_BYTES]
+ *
+ * The buffer is read once, on the first use of a macro key, and all
+ * playback is done from RAM. After a recording ends the changed bytes
+ * are written back one at a time whenever the keyboard is idle, so
+ * recording never waits for the EEPROM. The magic is cleared while the
+ * copy is being rewritten, so an interrupted write-back loses the
+ * macros instead of loading garbage.
+ */
+#include "eeprom.h"
+#include "eeconfig.h"
+
+#define DM_EEPROM_MAGIC  0xD14C
+#define DM_EEPROM_HEADER 8
+
+#ifndef DYNAMIC_MACRO_EEPROM_SIZE
+#   if defined(E2END)
+#       define DYNAMIC_MACRO_EEPROM_SIZE (E2END + 1 - (uintptr_t)EECONFIG_DYNAMIC_MACRO)
+#   else
+#       define DYNAMIC_MACRO_EEPROM_SIZE (1024 - (uintptr_t)EECONFIG_DYNAMIC_MACRO)
+#   endif
+#endif
+
+_Static_assert(DM_EEPROM_HEADER + DYNAMIC_MACRO_BYTES <= DYNAMIC_MACRO_EEPROM_SIZE,
+               "DYNAMIC_MACRO_SIZE is too large to fit the EEPROM, lower it or set DYNAMIC_MACRO_EEPROM_SIZE");
+
+enum {
+    DM_SYNC_IDLE,
+    DM_SYNC_INVALIDATE,
+    DM_SYNC_DATA,
+    DM_SYNC_VALIDATE,
+};
+
+static bool dynamic_macro_loaded = false;
+static uint8_t dynamic_macro_sync_state = DM_SYNC_IDLE;
+/* Next EEPROM image byte to compare and the changed range of the buffer,
+ * all as offsets into the EEPROM region. */
+static uint16_t dynamic_macro_sync_pos;
+static uint16_t dynamic_macro_sync_lo;
+static uint16_t dynamic_macro_sync_end;
+
+static uint8_t dynamic_macro_image_byte(uint16_t i)
+{
+    if (i >= DM_EEPROM_HEADER) {
+        return macro_buffer[i - DM_EEPROM_HEADER];
+    }
+
+    uint16_t header[DM_EEPROM_HEADER / 2] = {
+        DM_EEPROM_MAGIC,
+        DYNAMIC_MACRO_BYTES,
+        macro_end - macro_buffer,
+        r_macro_end - macro_buffer,
+    };
+    return ((uint8_t *)header)[i];
+}
+
+/* Load the macros saved in the EEPROM, if there are any. */
+static void dynamic_macro_load(void)
+{
+    if (dynamic_macro_loaded) {
+        return;
+    }
+    dynamic_macro_loaded = true;
+
+    uint16_t header[DM_EEPROM_HEADER / 2];
+    eeprom_read_block(header, EECONFIG_DYNAMIC_MACRO, DM_EEPROM_HEADER);
+
+    uint16_t end = header[2];
+    uint16_t r_end = header[3];
+    if (header[0] != DM_EEPROM_MAGIC || header[1] != DYNAMIC_MACRO_BYTES ||
+        r_end >= DYNAMIC_MACRO_BYTES || end > r_end + 1) {
+        return;
+    }
+
+    eeprom_read_block(macro_buffer, EECONFIG_DYNAMIC_MACRO + DM_EEPROM_HEADER, end);
+    eeprom_read_block(macro_buffer + r_end + 1,
+                      EECONFIG_DYNAMIC_MACRO + DM_EEPROM_HEADER + r_end + 1,
+                      DYNAMIC_MACRO_BYTES - r_end - 1);
+    macro_end = macro_buffer + end;
+    r_macro_end = macro_buffer + r_end;
+}
+
+/* Schedule the buffer bytes [lo, hi) to be written back. */
+static void dynamic_macro_save(uint16_t lo, uint16_t hi)
+{
+    lo += DM_EEPROM_HEADER;
+    hi += DM_EEPROM_HEADER;
+
+    if (dynamic_macro_sync_state == DM_SYNC_IDLE) {
+        dynamic_macro_sync_state = DM_SYNC_INVALIDATE;
+        dynamic_macro_sync_lo = lo;
+        dynamic_macro_sync_end = hi;
+    } else {
+        if (lo < dynamic_macro_sync_lo) {
+            dynamic_macro_sync_lo = lo;
+        }
+        if (hi > dynamic_macro_sync_end) {
+            dynamic_macro_sync_end = hi;
+        }
+        if (dynamic_macro_sync_state == DM_SYNC_VALIDATE) {
+            dynamic_macro_sync_state = DM_SYNC_DATA;
+        }
+    }
+    /* The header changes too, so always start right after the magic. */
+    dynamic_macro_sync_pos = 2;
+}
+
+/* Write back at most one changed byte, and only while nothing else is
+ * going on. */
+static void dynamic_macro_sync(void)
+{
+    if (dynamic_macro_sync_state == DM_SYNC_IDLE || macro_id ||
+        dynamic_macro_player.playing || has_anykey() || !eeprom_is_ready()) {
+        return;
+    }
+
+    uint8_t *base = EECONFIG_DYNAMIC_MACRO;
+
+    switch (dynamic_macro_sync_state) {
+    case DM_SYNC_INVALIDATE:
+        eeprom_update_byte(base, (uint8_t)~DM_EEPROM_MAGIC);
+        dynamic_macro_sync_state = DM_SYNC_DATA;
+        break;
+    case DM_SYNC_DATA:
+        /* Comparing is cheap, only writes have to wait for the EEPROM. */
+        for (uint8_t i = 0; i < 16; i++) {
+            if (dynamic_macro_sync_pos == DM_EEPROM_HEADER) {
+                /* skip the unchanged part between header and data */
+                dynamic_macro_sync_pos = dynamic_macro_sync_lo;
+            }
+            if (dynamic_macro_sync_pos >= dynamic_macro_sync_end) {
+                dynamic_macro_sync_state = DM_SYNC_VALIDATE;
+                dynamic_macro_sync_pos = 0;
+                break;
+            }
+            uint16_t pos = dynamic_macro_sync_pos++;
+            uint8_t value = dynamic_macro_image_byte(pos);
+            if (eeprom_read_byte(base + pos) != value) {
+                eeprom_write_byte(base + pos, value);
+                break;
+            }
+        }
+        break;
+    case DM_SYNC_VALIDATE:
+        eeprom_update_byte(base + dynamic_macro_sync_pos,
+                           dynamic_macro_image_byte(dynamic_macro_sync_pos));
+        if (++dynamic_macro_sync_pos == 2) {
+            dynamic_macro_sync_state = DM_SYNC_IDLE;
+        }
+        break;
+    }
+}
+#endif
+
 /* Blink the LEDs to notify the user about some event. */
 void dynamic_macro_led_blink(void)
 {
@@ -36,6 +287,12 @@ void dynamic_macro_led_blink(void)
     backlight_toggle();
 }
 
+/* Set the playback speed in percent, 0 plays back without delays. */
+void dynamic_macro_set_speed(uint8_t percent)
+{
+    dynamic_macro_speed = percent;
+}
+
 /**
  * Start recording of the dynamic macro.
  *
@@ -43,38 +300,123 @@ void dynamic_macro_led_blink(void)
  * @param[in]  macro_buffer  The macro buffer used to initialize macro_pointer.
  */
 void dynamic_macro_record_start(
-    keyrecord_t **macro_pointer, keyrecord_t *macro_buffer)
+    uint8_t **macro_pointer, uint8_t *macro_buffer)
 {
     dynamic_macro_led_blink();
 
     clear_keyboard();
     layer_clear();
     *macro_pointer = macro_buffer;
+    dynamic_macro_record_time = 0;
+}
+
+/**
+ * Decode the event at the playback pointer into dynamic_macro_player.
+ *
+ * @return false at the end of the macro.
+ */
+static bool dynamic_macro_next_event(void)
+{
+    if (dynamic_macro_player.pointer == dynamic_macro_player.end) {
+        return false;
+    }
+
+    int8_t direction = dynamic_macro_player.direction;
+    uint8_t *p = dynamic_macro_player.pointer;
+    uint8_t key = *p;
+    p += direction;
+    uint8_t flags = *p;
+    p += direction;
+
+    uint32_t delta = flags & DM_DELTA;
+    uint8_t shift = 5;
+    uint8_t more = flags & DM_MORE;
+    while (more) {
+        more = *p & 0x80;
+        delta |= (uint32_t)(*p & 0x7F) << shift;
+        shift += 7;
+        p += direction;
+    }
+
+    keyrecord_t *record = &dynamic_macro_player.record;
+    *record = (keyrecord_t){};
+    record->event.key = (keypos_t){ .row = key / MATRIX_COLS, .col = key % MATRIX_COLS };
+    record->event.pressed = flags & DM_PRESSED;
+    if (flags & DM_TAP) {
+#ifndef NO_ACTION_TAPPING
+        *(uint8_t *)&record->tap = *p;
+#endif
+        p += direction;
+    }
+
+    dynamic_macro_player.pointer = p;
+    if (dynamic_macro_speed) {
+        delta = delta * 100 / dynamic_macro_speed;
+    } else {
+        delta = 0;
+    }
+    dynamic_macro_player.delay = delta > 0xFFFF ? 0xFFFF : delta;
+    return true;
+}
+
+static void dynamic_macro_stop(void)
+{
+    clear_keyboard();
+    layer_state = dynamic_macro_player.saved_layer_state;
+    dynamic_macro_player.playing = false;
 }
 
 /**
- * Play the dynamic macro.
+ * Start playing the dynamic macro. The events are sent by
+ * dynamic_macro_task() with their recorded timing.
  *
  * @param macro_buffer[in] The beginning of the macro buffer being played.
  * @param macro_end[in]    The element after the last macro buffer element.
  * @param direction[in]    Either +1 or -1, which way to iterate the buffer.
  */
 void dynamic_macro_play(
-    keyrecord_t *macro_buffer, keyrecord_t *macro_end, int8_t direction)
+    uint8_t *macro_buffer, uint8_t *macro_end, int8_t direction)
 {
-    uint32_t saved_layer_state = layer_state;
+    dynamic_macro_player.saved_layer_state = layer_state;
 
     clear_keyboard();
     layer_clear();
 
-    while (macro_buffer != macro_end) {
-        process_record(macro_buffer);
-        macro_buffer += direction;
+    dynamic_macro_player.pointer = macro_buffer;
+    dynamic_macro_player.end = macro_end;
+    dynamic_macro_player.direction = direction;
+    dynamic_macro_player.timer = timer_read();
+    dynamic_macro_player.playing = dynamic_macro_next_event();
+    if (!dynamic_macro_player.playing) {
+        dynamic_macro_stop();
     }
+}
 
-    clear_keyboard();
+/* Send the next due event of the macro being played. Should be called
+ * from matrix_scan_user().
+ */
+void dynamic_macro_task(void)
+{
+#ifdef DYNAMIC_MACRO_EEPROM
+    dynamic_macro_sync();
+#endif
+
+    if (!dynamic_macro_player.playing) {
+        return;
+    }
+    if (timer_elapsed(dynamic_macro_player.timer) < dynamic_macro_player.delay) {
+        return;
+    }
 
-    layer_state = saved_layer_state;
+    /* Count the next delay from when this event was due, not from
+     * when it got sent, so a slow scan doesn't stretch the macro. */
+    dynamic_macro_player.timer += dynamic_macro_player.delay;
+    dynamic_macro_player.record.event.time = timer_read() | 1;
+    process_record(&dynamic_macro_player.record);
+
+    if (!dynamic_macro_next_event()) {
+        dynamic_macro_stop();
+    }
 }
 
 /**
@@ -86,14 +428,46 @@ void dynamic_macro_play(
  * @param record[in]     The current keypress.
  */
 void dynamic_macro_record_key(
-    keyrecord_t **macro_pointer,
-    keyrecord_t *macro_end2,
+    uint8_t **macro_pointer,
+    uint8_t *macro_end2,
     int8_t direction,
     keyrecord_t *record)
 {
-    if (*macro_pointer + direction != macro_end2) {
-        **macro_pointer = *record;
-        *macro_pointer += direction;
+    uint8_t event[DM_EVENT_MAX];
+    uint8_t length = 0;
+    uint16_t delta = 0;
+
+    if (dynamic_macro_record_time) {
+        delta = record->event.time - dynamic_macro_record_time;
+    }
+
+    event[length++] = record->event.key.row * MATRIX_COLS + record->event.key.col;
+    event[length++] = (record->event.pressed ? DM_PRESSED : 0)
+        | (delta > DM_DELTA ? DM_MORE : 0)
+        | (delta & DM_DELTA);
+    delta >>= 5;
+    while (delta) {
+        event[length++] = (delta > 0x7F ? 0x80 : 0) | (delta & 0x7F);
+        delta >>= 7;
+    }
+#ifndef NO_ACTION_TAPPING
+    uint8_t tap = *(uint8_t *)&record->tap;
+    if (tap) {
+        event[1] |= DM_TAP;
+        event[length++] = tap;
+    }
+#endif
+
+    /* The bytes between the two macros, inclusive of macro_end2 which
+     * is the next free byte of the other macro. */
+    int16_t space = (macro_end2 - *macro_pointer) * direction + 1;
+
+    if (space >= length) {
+        for (uint8_t i = 0; i < length; i++) {
+            **macro_pointer = event[i];
+            *macro_pointer += direction;
+        }
+        dynamic_macro_record_time = record->event.time;
     } else {
         /* Notify about the end of buffer. The blinks are paired
          * because they should happen on both down and up events. */
@@ -105,11 +479,19 @@ void dynamic_macro_record_key(
  * End recording of the dynamic macro. Essentially just update the
  * pointer to the end of the macro.
  */
-void dynamic_macro_record_end(keyrecord_t *macro_pointer, keyrecord_t **macro_end)
+void dynamic_macro_record_end(uint8_t *macro_pointer, uint8_t **macro_end)
 {
     dynamic_macro_led_blink();
 
     *macro_end = macro_pointer;
+
+#ifdef DYNAMIC_MACRO_EEPROM
+    if (macro_end == &r_macro_end) {
+        dynamic_macro_save(r_macro_end - macro_buffer + 1, DYNAMIC_MACRO_BYTES);
+    } else {
+        dynamic_macro_save(0, *macro_end - macro_buffer);
+    }
+#endif
 }
 
 /* Handle the key events related to the dynamic macros. Should be
@@ -121,56 +503,42 @@ void dynamic_macro_record_end(keyrecord_t *macro_pointer, keyrecord_t **macro_en
  *       }
  *       <...THE REST OF THE FUNCTION...>
  *   }
+ *
+ * The playback additionally needs dynamic_macro_task() to be called
+ * from matrix_scan_user().
+ *
+ * Define DYNAMIC_MACRO_EEPROM to keep the macros across power cycles.
  */
 bool process_record_dynamic_macro(uint16_t keycode, keyrecord_t *record)
 {
-    /* Both macros use the same buffer but read/write on different
-     * ends of it.
-     *
-     * Macro1 is written left-to-right starting from the beginning of
-     * the buffer.
-     *
-     * Macro2 is written right-to-left starting from the end of the
-     * buffer.
-     *
-     * &macro_buffer   macro_end
-     *  v                   v
-     * +------------------------------------------------------------+
-     * |>>>>>> MACRO1 >>>>>>|    |<<<<<<<<<<<<< MACRO2 <<<<<<<<<<<<<|
-     * +------------------------------------------------------------+
-     *                           ^                                 ^
-     *                         r_macro_end                  r_macro_buffer
-     *
-     * During the recording when one macro encounters the end of the
-     * other macro, the recording is stopped. Apart from this, there
-     * are no arbitrary limits for the macros' length in relation to
-     * each other: for example one can either have two medium sized
-     * macros or one long macro and one short macro. Or even one empty
-     * and one using the whole buffer.
-     */
-    static keyrecord_t macro_buffer[DYNAMIC_MACRO_SIZE];
-
-    /* Pointer to the first buffer element after the first macro.
-     * Initially points to the very beginning of the buffer since the
-     * macro is empty. */
-    static keyrecord_t *macro_end = macro_buffer;
-
-    /* The other end of the macro buffer. Serves as the beginning of
-     * the second macro. */
-    static keyrecord_t *const r_macro_buffer = macro_buffer + DYNAMIC_MACRO_SIZE - 1;
-
-    /* Like macro_end but for the second macro. */
-    static keyrecord_t *r_macro_end = r_macro_buffer;
-
     /* A persistent pointer to the current macro position (iterator)
      * used during the recording. */
-    static keyrecord_t *macro_pointer = NULL;
+    static uint8_t *macro_pointer = NULL;
 
-    /* 0   - no macro is being recorded right now
-     * 1,2 - either macro 1 or 2 is being recorded */
-    static uint8_t macro_id = 0;
+#ifdef DYNAMIC_MACRO_EEPROM
+    switch (keycode) {
+    case DYN_REC_START1:
+    case DYN_REC_START2:
+    case DYN_MACRO_PLAY1:
+    case DYN_MACRO_PLAY2:
+        dynamic_macro_load();
+        break;
+    }
+#endif
 
-    if (macro_id == 0) {
+    if (dynamic_macro_player.playing) {
+        /* Any of the macro keys stops the playback. */
+        switch (keycode) {
+        case DYN_REC_START1:
+        case DYN_REC_START2:
+        case DYN_MACRO_PLAY1:
+        case DYN_MACRO_PLAY2:
+            if (!record->event.pressed) {
+                dynamic_macro_stop();
+            }
+            return false;
+        }
+    } else if (macro_id == 0) {
         /* No macro recording in progress. */
         if (!record->event.pressed) {
             switch (keycode) {
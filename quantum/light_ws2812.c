@@ -255,6 +255,10 @@ void inline ws2812_sendarray_mask(uint8_t *data,uint16_t datlen,uint8_t maskhi)
 {
   uint8_t curbyte,ctr,masklo;
   uint8_t sreg_prev;
+#if WS2812_CHUNK_BYTES
+  uint8_t pinmask = maskhi;
+  uint16_t chunk = WS2812_CHUNK_BYTES;
+#endif
 
   // masklo  =~maskhi&ws2812_PORTREG;
   // maskhi |=        ws2812_PORTREG;
@@ -264,6 +268,17 @@ void inline ws2812_sendarray_mask(uint8_t *data,uint16_t datlen,uint8_t maskhi)
   cli();
 
   while (datlen--) {
+#if WS2812_CHUNK_BYTES
+    if (!chunk--) {
+      // let pending interrupts run, they may have changed the rest of the port
+      chunk = WS2812_CHUNK_BYTES - 1;
+      SREG=sreg_prev;
+      asm volatile("nop\n\t");
+      cli();
+      masklo  =~pinmask&_SFR_IO8((RGB_DI_PIN >> 4) + 2);
+      maskhi  = pinmask|_SFR_IO8((RGB_DI_PIN >> 4) + 2);
+    }
+#endif
     curbyte=(*data++);
 
     asm volatile(
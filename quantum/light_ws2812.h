@@ -61,6 +61,16 @@ void ws2812_setleds_rgbw(LED_TYPE *ledarray, uint16_t number_of_leds);
  * The length is the number of bytes to send - three per LED.
  */
 
+/*
+ * Interrupts are off while the bytes go out, 10us each. With
+ * WS2812_CHUNK_BYTES set pending interrupts run after every that many bytes,
+ * so USB and the timer wait no longer than one chunk. A handler that takes
+ * longer than the LEDs' reset time, 50us for WS2812, ends the frame early.
+ */
+#ifndef WS2812_CHUNK_BYTES
+#define WS2812_CHUNK_BYTES 0
+#endif
+
 void ws2812_sendarray     (uint8_t *array,uint16_t length);
 void ws2812_sendarray_mask(uint8_t *array,uint16_t length, uint8_t pinmask);
 
@@ -2,9 +2,78 @@
 
 qk_ucis_state_t qk_ucis_state;
 
+#ifdef UCIS_TRIE
+/* The trie is generated by quantum/tools/ucis_trie.py. Each node is
+ *   lo(2) hi(2) flags|children(1) { keycode(1) offset(2) } * children
+ * with [lo, hi) the range of sorted symbols sharing the node's prefix.
+ */
+extern const uint8_t ucis_trie[] PROGMEM;
+extern const uint32_t ucis_trie_codes[] PROGMEM;
+
+#define UCIS_TRIE_TERMINAL 0x80
+#define UCIS_TRIE_NONE 0xFFFF
+
+static uint16_t trie_read_word(uint16_t offset) {
+  return (pgm_read_byte(&ucis_trie[offset]) << 8) | pgm_read_byte(&ucis_trie[offset + 1]);
+}
+
+static uint8_t trie_children(uint16_t node) {
+  return pgm_read_byte(&ucis_trie[node + 4]) & ~UCIS_TRIE_TERMINAL;
+}
+
+static bool trie_is_terminal(uint16_t node) {
+  return pgm_read_byte(&ucis_trie[node + 4]) & UCIS_TRIE_TERMINAL;
+}
+
+static uint16_t trie_child(uint16_t node, uint16_t keycode) {
+  uint8_t children = trie_children(node);
+  uint16_t edge = node + 5;
+
+  for (; children; children--, edge += 3) {
+    uint8_t kc = pgm_read_byte(&ucis_trie[edge]);
+    if (kc == keycode) {
+      return trie_read_word(edge + 1);
+    }
+    // edges are sorted by keycode
+    if (kc > keycode) {
+      break;
+    }
+  }
+  return UCIS_TRIE_NONE;
+}
+
+static uint16_t trie_walk(void) {
+  uint16_t node = 0;
+
+  for (uint8_t i = 0; i < qk_ucis_state.count && node != UCIS_TRIE_NONE; i++) {
+    node = trie_child(node, qk_ucis_state.codes[i]);
+  }
+  return node;
+}
+
+static void register_ucis_code(uint32_t code) {
+  bool leading = true;
+
+  for (int i = 7; i >= 0; i--) {
+    uint8_t digit = (code >> (i*4)) & 0xF;
+    if (digit || i < 4) {
+      leading = false;
+    }
+    if (!leading) {
+      register_code(hex_to_keycode(digit));
+      unregister_code(hex_to_keycode(digit));
+      wait_ms(UNICODE_TYPE_DELAY);
+    }
+  }
+}
+#endif
+
 void qk_ucis_start(void) {
   qk_ucis_state.count = 0;
   qk_ucis_state.in_progress = true;
+#ifdef UCIS_TRIE
+  qk_ucis_state.node = 0;
+#endif
 
   qk_ucis_start_user();
 }
@@ -72,9 +141,15 @@ void register_ucis(const char *hex) {
   }
 }
 
-bool process_ucis (uint16_t keycode, keyrecord_t *record) {
-  uint8_t i;
+static void ucis_erase(void) {
+  for (uint8_t i = qk_ucis_state.count; i > 0; i--) {
+    register_code (KC_BSPC);
+    unregister_code (KC_BSPC);
+    wait_ms(UNICODE_TYPE_DELAY);
+  }
+}
 
+bool process_ucis (uint16_t keycode, keyrecord_t *record) {
   if (!qk_ucis_state.in_progress)
     return true;
 
@@ -92,6 +167,9 @@ bool process_ucis (uint16_t keycode, keyrecord_t *record) {
   if (keycode == KC_BSPC) {
     if (qk_ucis_state.count >= 2) {
       qk_ucis_state.count -= 2;
+#ifdef UCIS_TRIE
+      qk_ucis_state.node = trie_walk();
+#endif
       return true;
     } else {
       qk_ucis_state.count--;
@@ -102,11 +180,7 @@ bool process_ucis (uint16_t keycode, keyrecord_t *record) {
   if (keycode == KC_ENT || keycode == KC_SPC || keycode == KC_ESC) {
     bool symbol_found = false;
 
-    for (i = qk_ucis_state.count; i > 0; i--) {
-      register_code (KC_BSPC);
-      unregister_code (KC_BSPC);
-      wait_ms(UNICODE_TYPE_DELAY);
-    }
+    ucis_erase();
 
     if (keycode == KC_ESC) {
       qk_ucis_state.in_progress = false;
@@ -114,13 +188,21 @@ bool process_ucis (uint16_t keycode, keyrecord_t *record) {
     }
 
     unicode_input_start();
-    for (i = 0; ucis_symbol_table[i].symbol; i++) {
+#ifdef UCIS_TRIE
+    uint16_t node = qk_ucis_state.node;
+    if (node != UCIS_TRIE_NONE && trie_is_terminal(node)) {
+      symbol_found = true;
+      register_ucis_code(pgm_read_dword(&ucis_trie_codes[trie_read_word(node)]));
+    }
+#else
+    for (uint8_t i = 0; ucis_symbol_table[i].symbol; i++) {
       if (is_uni_seq (ucis_symbol_table[i].symbol)) {
         symbol_found = true;
         register_ucis(ucis_symbol_table[i].code + 2);
         break;
       }
     }
+#endif
     if (!symbol_found) {
       qk_ucis_symbol_fallback();
     }
@@ -129,5 +211,27 @@ bool process_ucis (uint16_t keycode, keyrecord_t *record) {
     qk_ucis_state.in_progress = false;
     return false;
   }
+
+#ifdef UCIS_TRIE
+  uint16_t node = trie_child(qk_ucis_state.node, keycode);
+  qk_ucis_state.node = node;
+
+  if (node == UCIS_TRIE_NONE) {
+    // no symbol starts like this, give up and leave the typed text alone,
+    // this key included, it is already what the fallback would type again
+    qk_ucis_state.in_progress = false;
+    return true;
+  }
+
+  if (trie_is_terminal(node) && !trie_children(node)) {
+    // the only candidate left is complete, no need to wait for Enter
+    ucis_erase();
+    unicode_input_start();
+    register_ucis_code(pgm_read_dword(&ucis_trie_codes[trie_read_word(node)]));
+    unicode_input_finish();
+    qk_ucis_state.in_progress = false;
+    return false;
+  }
+#endif
   return true;
 }
\ No newline at end of file
@@ -16,6 +16,9 @@ typedef struct {
 typedef struct {
   uint8_t count;
   uint16_t codes[UCIS_MAX_SYMBOL_LENGTH];
+#ifdef UCIS_TRIE
+  uint16_t node;
+#endif
   bool in_progress:1;
 } qk_ucis_state_t;
 
@@ -11,8 +11,7 @@ uint8_t get_unicode_input_mode(void) {
   return input_mode;
 }
 
-__attribute__((weak))
-void unicode_input_start (void) {
+static void unicode_input_enter(void) {
   // save current mods
   mods = keyboard_report->mods;
 
@@ -49,7 +48,17 @@ void unicode_input_start (void) {
     register_code(KC_U);
     unregister_code(KC_U);
   }
-  wait_ms(UNICODE_TYPE_DELAY);
+}
+
+// unicode_task() waits for the OS itself, without blocking the scan
+static bool uq_typing = false;
+
+__attribute__((weak))
+void unicode_input_start (void) {
+  unicode_input_enter();
+  if (!uq_typing) {
+    wait_ms(UNICODE_TYPE_DELAY);
+  }
 }
 
 __attribute__((weak))
@@ -82,4 +91,197 @@ void register_hex(uint16_t hex) {
     register_code(hex_to_keycode(digit));
     unregister_code(hex_to_keycode(digit));
   }
-}
\ No newline at end of file
+}
+
+/* Unicode typing queue
+ *
+ * Keycodes are buffered here and tapped from unicode_task(), a few per scan,
+ * so the matrix keeps getting scanned while a string is being typed. The
+ * UQ_BEGIN/UQ_END markers enter and leave the OS input mode; on OS X the
+ * input mode is held across consecutive code points of one string.
+ */
+#define UQ_BEGIN 0xF0
+#define UQ_END   0xF1
+
+static uint8_t uq_buf[UNICODE_QUEUE_SIZE];
+static uint8_t uq_head = 0;
+static uint8_t uq_tail = 0;
+static uint16_t uq_timer = 0;
+static bool uq_waiting = false;
+
+static inline uint8_t uq_count(void) {
+  return (uint8_t)(uq_head + UNICODE_QUEUE_SIZE - uq_tail) % UNICODE_QUEUE_SIZE;
+}
+
+static inline void uq_push(uint8_t item) {
+  uq_buf[uq_head] = item;
+  uq_head = (uq_head + 1) % UNICODE_QUEUE_SIZE;
+}
+
+static void uq_push_hex(uint32_t hex, uint8_t min_digits) {
+  bool leading = true;
+  for (int i = 7; i >= 0; i--) {
+    uint8_t digit = ((hex >> (i*4)) & 0xF);
+    if (digit || i < min_digits) {
+      leading = false;
+    }
+    if (!leading) {
+      uq_push(hex_to_keycode(digit));
+    }
+  }
+}
+
+static void uq_begin(uint8_t mode) {
+  uint8_t last = (uq_head + UNICODE_QUEUE_SIZE - 1) % UNICODE_QUEUE_SIZE;
+  if (mode == UC_OSX && uq_head != uq_tail && uq_buf[last] == UQ_END) {
+    // still holding the input mode for the previous code point, reuse it
+    uq_head = last;
+  } else {
+    uq_push(UQ_BEGIN);
+  }
+}
+
+bool unicode_queue_busy(void) {
+  return uq_head != uq_tail || uq_waiting;
+}
+
+uint8_t unicode_queue_code_point(uint32_t code_point) {
+  uint8_t mode = get_unicode_input_mode();
+  bool surrogates = (mode == UC_OSX && code_point > 0xFFFF);
+
+  if (code_point > 0x10FFFF) {
+    return UNICODE_INVALID;
+  }
+  // worst case is a surrogate pair or eight digits, plus both markers
+  if (uq_count() + 10 >= UNICODE_QUEUE_SIZE) {
+    return UNICODE_QUEUE_FULL;
+  }
+
+  uq_begin(mode);
+
+  if (surrogates) {
+    code_point -= 0x10000;
+    uq_push_hex(0xD800 + (code_point >> 10), 4);
+    uq_push_hex(0xDC00 + (code_point & 0x3FF), 4);
+  } else {
+    uq_push_hex(code_point, 4);
+  }
+  uq_push(UQ_END);
+  return UNICODE_QUEUED;
+}
+
+uint8_t unicode_queue_keycodes_P(const uint8_t *keycodes, uint8_t length) {
+  if (length + 2 >= UNICODE_QUEUE_SIZE) {
+    return UNICODE_INVALID;
+  }
+  if (uq_count() + length + 2 >= UNICODE_QUEUE_SIZE) {
+    return UNICODE_QUEUE_FULL;
+  }
+
+  uq_begin(get_unicode_input_mode());
+  for (uint8_t i = 0; i < length; i++) {
+    uq_push(pgm_read_byte(&keycodes[i]));
+  }
+  uq_push(UQ_END);
+  return UNICODE_QUEUED;
+}
+
+/* Decodes one UTF-8 sequence, returns the number of bytes consumed or 0 on
+ * the terminating NUL. Malformed and overlong sequences, surrogates and
+ * anything above U+10FFFF decode as U+FFFD.
+ */
+static uint8_t decode_utf8(const char *str, bool pgm, uint32_t *code_point) {
+  uint8_t c = pgm ? pgm_read_byte(str) : (uint8_t)str[0];
+  uint8_t len;
+
+  if (c == 0) {
+    return 0;
+  } else if (c < 0x80) {
+    *code_point = c;
+    return 1;
+  } else if ((c & 0xE0) == 0xC0) {
+    *code_point = c & 0x1F;
+    len = 2;
+  } else if ((c & 0xF0) == 0xE0) {
+    *code_point = c & 0x0F;
+    len = 3;
+  } else if ((c & 0xF8) == 0xF0) {
+    *code_point = c & 0x07;
+    len = 4;
+  } else {
+    *code_point = 0xFFFD;
+    return 1;
+  }
+
+  for (uint8_t i = 1; i < len; i++) {
+    c = pgm ? pgm_read_byte(str + i) : (uint8_t)str[i];
+    if ((c & 0xC0) != 0x80) {
+      *code_point = 0xFFFD;
+      return i;
+    }
+    *code_point = (*code_point << 6) | (c & 0x3F);
+  }
+  if (*code_point < (len == 2 ? 0x80 : len == 3 ? 0x800 : 0x10000) ||
+      (*code_point >= 0xD800 && *code_point <= 0xDFFF) || *code_point > 0x10FFFF) {
+    *code_point = 0xFFFD;
+  }
+  return len;
+}
+
+static void queue_unicode_string(const char *str, bool pgm) {
+  uint32_t code_point;
+  uint8_t len;
+
+  while ((len = decode_utf8(str, pgm, &code_point))) {
+    while (unicode_queue_code_point(code_point) == UNICODE_QUEUE_FULL) {
+      // queue is full, type out what is already there to make room
+      unicode_task();
+    }
+    str += len;
+  }
+}
+
+void send_unicode_string(const char *str) {
+  queue_unicode_string(str, false);
+}
+
+void send_unicode_string_P(const char *str) {
+  queue_unicode_string(str, true);
+}
+
+void unicode_task(void) {
+  if (uq_waiting) {
+    if (timer_elapsed(uq_timer) < UNICODE_TYPE_DELAY) {
+      return;
+    }
+    uq_waiting = false;
+  }
+
+  for (uint8_t i = 0; i < UNICODE_TAPS_PER_TASK && uq_head != uq_tail; i++) {
+    uint8_t item = uq_buf[uq_tail];
+    uq_tail = (uq_tail + 1) % UNICODE_QUEUE_SIZE;
+
+    switch (item) {
+    case UQ_BEGIN:
+      uq_typing = true;
+      unicode_input_start();
+      uq_typing = false;
+      uq_timer = timer_read();
+      uq_waiting = true;
+      return;
+    case UQ_END:
+      unicode_input_finish();
+      break;
+    default:
+      register_code(item);
+      unregister_code(item);
+      break;
+    }
+  }
+}
+
+void unicode_flush(void) {
+  while (unicode_queue_busy()) {
+    unicode_task();
+  }
+}
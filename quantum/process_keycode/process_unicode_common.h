@@ -7,6 +7,16 @@
 #define UNICODE_TYPE_DELAY 10
 #endif
 
+// size of the typing queue used by send_unicode_string
+#ifndef UNICODE_QUEUE_SIZE
+#define UNICODE_QUEUE_SIZE 64
+#endif
+
+// number of queued keys tapped per unicode_task() call
+#ifndef UNICODE_TAPS_PER_TASK
+#define UNICODE_TAPS_PER_TASK 2
+#endif
+
 __attribute__ ((unused))
 static uint8_t input_mode;
 
@@ -16,6 +26,30 @@ void unicode_input_start(void);
 void unicode_input_finish(void);
 void register_hex(uint16_t hex);
 
+#if UNICODE_QUEUE_SIZE < 16 || UNICODE_QUEUE_SIZE > 255
+#error "UNICODE_QUEUE_SIZE must be between 16 and 255"
+#endif
+
+enum unicode_queue_status {
+  UNICODE_QUEUED,
+  UNICODE_QUEUE_FULL,   // try again after unicode_task()
+  UNICODE_INVALID       // will never fit or can't be typed
+};
+
+/* Non-blocking output, the queue is drained by unicode_task() from
+ * matrix_scan_quantum, and by unicode_flush() before the next key is
+ * processed. Strings are UTF-8.
+ */
+uint8_t unicode_queue_code_point(uint32_t code_point);
+uint8_t unicode_queue_keycodes_P(const uint8_t *keycodes, uint8_t length);
+bool unicode_queue_busy(void);
+void unicode_flush(void);
+void send_unicode_string(const char *str);
+void send_unicode_string_P(const char *str);
+void unicode_task(void);
+
+#define SEND_UNICODE_STRING(str) send_unicode_string_P(PSTR(str))
+
 #define UC_OSX 0  // Mac OS X
 #define UC_LNX 1  // Linux
 #define UC_WIN 2  // Windows 'HexNumpad'
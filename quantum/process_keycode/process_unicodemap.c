@@ -28,12 +28,50 @@ void register_hex32(uint32_t hex) {
 __attribute__((weak))
 void unicode_map_input_error() {}
 
+#ifdef UNICODEMAP_KEYCODES
+extern const uint8_t unicode_map_keycodes[][UNICODEMAP_SEQUENCE_LENGTH] PROGMEM;
+extern const uint8_t unicode_map_keycodes_osx[][UNICODEMAP_SEQUENCE_LENGTH] PROGMEM;
+
+bool process_unicode_map(uint16_t keycode, keyrecord_t *record) {
+  uint8_t input_mode = get_unicode_input_mode();
+  if ((keycode & QK_UNICODE_MAP) == QK_UNICODE_MAP && record->event.pressed) {
+    uint16_t index = keycode - QK_UNICODE_MAP;
+    const uint8_t *keycodes = (input_mode == UC_OSX) ?
+      unicode_map_keycodes_osx[index] : unicode_map_keycodes[index];
+    uint8_t length = 0;
+
+    while (length < UNICODEMAP_SEQUENCE_LENGTH && pgm_read_byte(&keycodes[length])) {
+      length++;
+    }
+    // empty rows can't be entered on OS X, Linux only takes five digits
+    if (length == 0 || (length > 5 && input_mode == UC_LNX)) {
+      unicode_map_input_error();
+      return true;
+    }
+    // typed from the queue, process_record_quantum() drains it before the
+    // next key so nothing lands in the middle of the sequence. Text that
+    // process_record_user() queued with SEND_STRING goes out first.
+    send_string_flush();
+    uint8_t status;
+    while ((status = unicode_queue_keycodes_P(keycodes, length)) == UNICODE_QUEUE_FULL) {
+      unicode_task();
+    }
+    if (status == UNICODE_INVALID) {
+      unicode_map_input_error();
+    }
+  }
+  return true;
+}
+#else
 bool process_unicode_map(uint16_t keycode, keyrecord_t *record) {
   uint8_t input_mode = get_unicode_input_mode();
   if ((keycode & QK_UNICODE_MAP) == QK_UNICODE_MAP && record->event.pressed) {
     const uint32_t* map = unicode_map;
     uint16_t index = keycode - QK_UNICODE_MAP;
     uint32_t code = pgm_read_dword_far(&map[index]);
+    // typed directly, after whatever process_record_user() queued
+    send_string_flush();
+    unicode_flush();
     if (code > 0xFFFF && code <= 0x10ffff && input_mode == UC_OSX) {
       // Convert to UTF-16 surrogate pair
       code -= 0x10000;
@@ -53,4 +91,5 @@ bool process_unicode_map(uint16_t keycode, keyrecord_t *record) {
     }
   }
   return true;
-}
\ No newline at end of file
+}
+#endif
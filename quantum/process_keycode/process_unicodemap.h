@@ -4,6 +4,9 @@
 #include "quantum.h"
 #include "process_unicode_common.h"
 
+// row width of the tables generated by quantum/tools/unicode_map_keycodes.py
+#define UNICODEMAP_SEQUENCE_LENGTH 8
+
 void unicode_map_input_error(void);
 bool process_unicode_map(uint16_t keycode, keyrecord_t *record);
 #endif
\ No newline at end of file
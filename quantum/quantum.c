@@ -8,6 +8,7 @@
 #endif
 
 #include "backlight.h"
+#include "loop_stats.h"
 extern backlight_config_t backlight_config;
 
 #ifdef FAUXCLICKY_ENABLE
@@ -123,6 +124,12 @@ static uint16_t scs_timer = 0;
 
 bool process_record_quantum(keyrecord_t *record) {
 
+  /* Finish typing queued strings before anything else hits the host */
+  send_string_flush();
+  #if defined(UNICODE_ENABLE) || defined(UCIS_ENABLE) || defined(UNICODEMAP_ENABLE)
+    unicode_flush();
+  #endif
+
   /* This gets the keycode from the key pressed */
   keypos_t key = record->event.key;
   uint16_t keycode;
@@ -143,6 +150,10 @@ bool process_record_quantum(keyrecord_t *record) {
   #endif
     keycode = keymap_key_to_keycode(layer_switch_get_layer(key), key);
 
+  #ifdef RGBLIGHT_REACTIVE_ENABLE
+    rgblight_reactive_record(key, record->event.pressed);
+  #endif
+
     // This is how you use actions here
     // if (keycode == KC_LEAD) {
     //   action_t action;
@@ -518,22 +529,72 @@ const uint8_t ascii_to_colemak_keycode_lut[0x80] PROGMEM = {
 
 #endif
 
+#ifndef SEND_STRING_QUEUE_SIZE
+#define SEND_STRING_QUEUE_SIZE 64
+#endif
+
+#ifndef SEND_STRING_CHARS_PER_POLL
+#define SEND_STRING_CHARS_PER_POLL 1
+#endif
+
+/* Characters waiting to be typed, drained by send_string_task() */
+static char send_string_queue[SEND_STRING_QUEUE_SIZE];
+static uint8_t send_string_head = 0;
+static uint8_t send_string_tail = 0;
+static uint8_t send_string_count = 0;
+static bool send_string_shifted = false;
+
+static void send_string_type(uint8_t ascii_code) {
+    if (ascii_code >= 0x80) return;
+    uint8_t keycode = pgm_read_byte(&ascii_to_qwerty_keycode_lut[ascii_code]);
+    if (!keycode) return;
+
+    /* Shift stays down across consecutive shifted characters */
+    bool shift = pgm_read_byte(&ascii_to_qwerty_shift_lut[ascii_code]);
+    if (shift != send_string_shifted) {
+        if (shift)
+            register_code(KC_LSFT);
+        else
+            unregister_code(KC_LSFT);
+        send_string_shifted = shift;
+    }
+    register_code(keycode);
+    unregister_code(keycode);
+}
+
+void send_string_task(void) {
+    for (uint8_t i = 0; i < SEND_STRING_CHARS_PER_POLL && send_string_count; i++) {
+        send_string_type(send_string_queue[send_string_tail]);
+        send_string_tail = (send_string_tail + 1) % SEND_STRING_QUEUE_SIZE;
+        send_string_count--;
+    }
+    if (!send_string_count && send_string_shifted) {
+        unregister_code(KC_LSFT);
+        send_string_shifted = false;
+    }
+}
+
+void send_string_flush(void) {
+    while (send_string_count) {
+        send_string_task();
+    }
+}
+
+bool send_string_busy(void) {
+    return send_string_count != 0;
+}
+
 void send_string(const char *str) {
     while (1) {
-        uint8_t keycode;
         uint8_t ascii_code = pgm_read_byte(str);
         if (!ascii_code) break;
-        keycode = pgm_read_byte(&ascii_to_qwerty_keycode_lut[ascii_code]);
-        if (pgm_read_byte(&ascii_to_qwerty_shift_lut[ascii_code])) {
-            register_code(KC_LSFT);
-            register_code(keycode);
-            unregister_code(keycode);
-            unregister_code(KC_LSFT);
-        }
-        else {
-            register_code(keycode);
-            unregister_code(keycode);
+        /* Only blocks for strings longer than the queue */
+        while (send_string_count == SEND_STRING_QUEUE_SIZE) {
+            send_string_task();
         }
+        send_string_queue[send_string_head] = ascii_code;
+        send_string_head = (send_string_head + 1) % SEND_STRING_QUEUE_SIZE;
+        send_string_count++;
         ++str;
     }
 }
@@ -604,8 +665,22 @@ void matrix_scan_quantum() {
     matrix_scan_combo();
   #endif
 
+  #if defined(UNICODE_ENABLE) || defined(UCIS_ENABLE) || defined(UNICODEMAP_ENABLE)
+    unicode_task();
+  #endif
+
+  send_string_task();
+
   #if defined(BACKLIGHT_ENABLE) && defined(BACKLIGHT_PIN)
+    LOOP_STATS_START(backlight_start);
     backlight_task();
+    LOOP_STATS_END(LOOP_STATS_BACKLIGHT, backlight_start);
+  #endif
+
+  #ifdef RGBLIGHT_ENABLE
+    LOOP_STATS_START(rgblight_start);
+    rgblight_task();
+    LOOP_STATS_END(LOOP_STATS_RGBLIGHT, rgblight_start);
   #endif
 
   matrix_scan_kb();
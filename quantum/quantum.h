@@ -15,6 +15,9 @@
 #ifdef RGBLIGHT_ENABLE
   #include "rgblight.h"
 #endif
+#ifdef RGBLIGHT_REACTIVE_ENABLE
+  #include "rgblight_reactive.h"
+#endif
 #include "action_layer.h"
 #include "eeconfig.h"
 #include <stddef.h>
@@ -74,8 +77,14 @@ extern uint32_t default_layer_state;
 	#include "process_combo.h"
 #endif
 
+/* Strings are queued and typed SEND_STRING_CHARS_PER_POLL characters per
+ * matrix scan. Call send_string_flush() before sending other keys from the
+ * same handler if they have to come after the string. */
 #define SEND_STRING(str) send_string(PSTR(str))
 void send_string(const char *str);
+void send_string_task(void);
+void send_string_flush(void);
+bool send_string_busy(void);
 
 // For tri-layer
 void update_tri_layer(uint8_t layer1, uint8_t layer2, uint8_t layer3);
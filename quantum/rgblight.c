@@ -1,9 +1,13 @@
 #include <avr/eeprom.h>
 #include <avr/interrupt.h>
 #include <util/delay.h>
+#include <string.h>
 #include "progmem.h"
 #include "timer.h"
 #include "rgblight.h"
+#ifdef RGBLIGHT_REACTIVE_ENABLE
+  #include "rgblight_reactive.h"
+#endif
 #include "debug.h"
 
 // Lightness curve using the CIE 1931 lightness formula
@@ -76,55 +80,71 @@ LED_TYPE led[RGBLED_NUM];
 uint8_t rgblight_inited = 0;
 bool rgblight_timer_enabled = false;
 
-void sethsv(uint16_t hue, uint8_t sat, uint8_t val, LED_TYPE *led1) {
-  uint8_t r = 0, g = 0, b = 0, base, color;
+// what the strip shows, frames equal to it aren't sent again
+static LED_TYPE led_sent[RGBLED_NUM];
+static bool led_sent_valid = false;
+static bool frame_pending = false;
+#if RGBLIGHT_MAX_FPS
+static uint16_t frame_timer = 0;
+#endif
 
-  if (sat == 0) { // Acromatic color (gray). Hue doesn't mind.
-    r = val;
-    g = val;
-    b = val;
-  } else {
-    base = ((255 - sat) * val) >> 8;
-    color = (val - base) * (hue % 60) / 60;
+#ifdef RGBLIGHT_LAYERS
+rgblight_layer_t rgblight_layers[RGBLIGHT_LAYER_COUNT] = {
+  [0 ... RGBLIGHT_LAYER_COUNT - 1] = { .blend = RGBLIGHT_BLEND_NORMAL, .opacity = 255 }
+};
+// led[] and the layers merged
+static LED_TYPE frame[RGBLED_NUM];
+// the LEDs of frame[] to merge again, none when dirty_first > dirty_last
+static uint8_t dirty_first = 0;
+static uint8_t dirty_last = RGBLED_NUM - 1;
+#endif
 
-    switch (hue / 60) {
+/* Hue in sextants of 256, see RGBLIGHT_HUE_FULL. sat and val are the same
+ * for every LED, so only the channel that moves within the sextant needs its
+ * own curve lookup and there is no division.
+ */
+void sethsv_leds(uint16_t hue, int16_t hue_step, uint8_t sat, uint8_t val, LED_TYPE *leds, uint8_t count) {
+  uint8_t base = sat ? ((uint16_t)(255 - sat) * val) >> 8 : val;
+  uint8_t range = val - base;
+  uint8_t top = pgm_read_byte(&DIM_CURVE[val]);
+  uint8_t bottom = pgm_read_byte(&DIM_CURVE[base]);
+
+  if (hue >= RGBLIGHT_HUE_FULL) hue %= RGBLIGHT_HUE_FULL;
+  if (hue_step <= -RGBLIGHT_HUE_FULL || hue_step >= RGBLIGHT_HUE_FULL) hue_step %= RGBLIGHT_HUE_FULL;
+  if (hue_step < 0) hue_step += RGBLIGHT_HUE_FULL;
+
+  for (; count; count--, leds++) {
+    uint8_t color = ((uint16_t)range * (uint8_t)hue) >> 8;
+
+    switch (hue >> 8) {
       case 0:
-        r = val;
-        g = base + color;
-        b = base;
+        setrgb(top, pgm_read_byte(&DIM_CURVE[base + color]), bottom, leds);
         break;
       case 1:
-        r = val - color;
-        g = val;
-        b = base;
+        setrgb(pgm_read_byte(&DIM_CURVE[val - color]), top, bottom, leds);
         break;
       case 2:
-        r = base;
-        g = val;
-        b = base + color;
+        setrgb(bottom, top, pgm_read_byte(&DIM_CURVE[base + color]), leds);
         break;
       case 3:
-        r = base;
-        g = val - color;
-        b = val;
+        setrgb(bottom, pgm_read_byte(&DIM_CURVE[val - color]), top, leds);
         break;
       case 4:
-        r = base + color;
-        g = base;
-        b = val;
+        setrgb(pgm_read_byte(&DIM_CURVE[base + color]), bottom, top, leds);
         break;
-      case 5:
-        r = val;
-        g = base;
-        b = val - color;
+      default:
+        setrgb(top, bottom, pgm_read_byte(&DIM_CURVE[val - color]), leds);
         break;
     }
+
+    hue += hue_step;
+    if (hue >= RGBLIGHT_HUE_FULL) hue -= RGBLIGHT_HUE_FULL;
   }
-  r = pgm_read_byte(&DIM_CURVE[r]);
-  g = pgm_read_byte(&DIM_CURVE[g]);
-  b = pgm_read_byte(&DIM_CURVE[b]);
+}
 
-  setrgb(r, g, b, led1);
+void sethsv(uint16_t hue, uint8_t sat, uint8_t val, LED_TYPE *led1) {
+  if (hue >= 360) hue %= 360;
+  sethsv_leds(RGBLIGHT_HUE_FROM_DEGREES(hue), 0, sat, val, led1, 1);
 }
 
 void setrgb(uint8_t r, uint8_t g, uint8_t b, LED_TYPE *led1) {
@@ -243,6 +263,11 @@ void rgblight_mode(uint8_t mode) {
   }
   eeconfig_update_rgblight(rgblight_config.raw);
   xprintf("rgblight mode: %u\n", rgblight_config.mode);
+#if defined(RGBLIGHT_REACTIVE_ENABLE) && defined(RGBLIGHT_LAYERS)
+  // the reactive layer starts over with every mode
+  rgblight_reactive_clear();
+  rgblight_layer_clear(RGBLIGHT_LAYER_REACTIVE);
+#endif
   if (rgblight_config.mode == 1) {
     #ifdef RGBLIGHT_ANIMATIONS
       rgblight_timer_disable();
@@ -263,6 +288,17 @@ void rgblight_mode(uint8_t mode) {
     #ifdef RGBLIGHT_ANIMATIONS
       rgblight_timer_disable();
     #endif
+#ifdef RGBLIGHT_REACTIVE_ENABLE
+  } else if (rgblight_config.mode >= RGBLIGHT_REACTIVE_MODE) {
+    // MODE 35-37, reactive fade, ripple and heatmap
+    rgblight_reactive_clear();
+    rgblight_timer_enable();
+  #ifdef RGBLIGHT_LAYERS
+    // drawn on the reactive layer, over a dark base
+    memset(led, 0, sizeof(led));
+    rgblight_set();
+  #endif
+#endif
   }
   rgblight_sethsv(rgblight_config.hue, rgblight_config.sat, rgblight_config.val);
 }
@@ -368,14 +404,12 @@ void rgblight_sethsv(uint16_t hue, uint8_t sat, uint8_t val) {
         hue = rgblight_config.hue;
       } else if (rgblight_config.mode >= 25 && rgblight_config.mode <= 34) {
         // static gradient
-        uint16_t _hue;
-        int8_t direction = ((rgblight_config.mode - 25) % 2) ? -1 : 1;
-        uint16_t range = pgm_read_word(&RGBLED_GRADIENT_RANGES[(rgblight_config.mode - 25) / 2]);
-        for (uint8_t i = 0; i < RGBLED_NUM; i++) {
-          _hue = (range / RGBLED_NUM * i * direction + hue + 360) % 360;
-          dprintf("rgblight rainbow set hsv: %u,%u,%d,%u\n", i, _hue, direction, range);
-          sethsv(_hue, sat, val, (LED_TYPE *)&led[i]);
+        int16_t step = RGBLIGHT_HUE_FROM_DEGREES(pgm_read_word(&RGBLED_GRADIENT_RANGES[(rgblight_config.mode - 25) / 2])) / RGBLED_NUM;
+        if ((rgblight_config.mode - 25) % 2) {
+          step = -step;
         }
+        dprintf("rgblight rainbow set hsv: %u,%d\n", hue, step);
+        sethsv_leds(RGBLIGHT_HUE_FROM_DEGREES(hue), step, sat, val, led, RGBLED_NUM);
         rgblight_set();
       }
     }
@@ -397,29 +431,220 @@ void rgblight_setrgb(uint8_t r, uint8_t g, uint8_t b) {
   rgblight_set();
 }
 
+#ifdef RGBLIGHT_LAYERS
+static uint8_t blend_channel(uint8_t blend, uint8_t below, uint8_t above, uint16_t alpha) {
+  uint16_t mixed;
+  switch (blend) {
+    case RGBLIGHT_BLEND_ADD:
+      mixed = below + above > 255 ? 255 : below + above;
+      break;
+    case RGBLIGHT_BLEND_MULTIPLY:
+      mixed = ((uint16_t)below * above + below) >> 8;
+      break;
+    case RGBLIGHT_BLEND_LIGHTEN:
+      mixed = below > above ? below : above;
+      break;
+    default:
+      mixed = above;
+      break;
+  }
+  // alpha 0 to 256
+  return (below * (256 - alpha) + mixed * alpha) >> 8;
+}
+
+static void rgblight_mark_dirty(uint8_t first, uint8_t last) {
+  if (first < dirty_first) {
+    dirty_first = first;
+  }
+  if (last > dirty_last) {
+    dirty_last = last;
+  }
+  frame_pending = true;
+}
+
+static void rgblight_compose(void) {
+  uint8_t first = dirty_first;
+  uint8_t last = dirty_last;
+  if (first > last) {
+    return;
+  }
+  dirty_first = RGBLED_NUM;
+  dirty_last = 0;
+
+  memcpy(&frame[first], &led[first], (last - first + 1) * sizeof(LED_TYPE));
+  for (uint8_t l = 0; l < RGBLIGHT_LAYER_COUNT; l++) {
+    const rgblight_layer_t *layer = &rgblight_layers[l];
+    if (!layer->opacity || (!rgblight_config.enable && l != RGBLIGHT_LAYER_OVERLAY)) {
+      continue;
+    }
+    for (uint8_t i = first; i <= last; i++) {
+      if (!layer->alpha[i]) {
+        continue;
+      }
+      uint16_t alpha = ((uint16_t)layer->alpha[i] * layer->opacity + layer->alpha[i]) >> 8;
+      alpha += alpha >> 7;
+      frame[i].r = blend_channel(layer->blend, frame[i].r, layer->led[i].r, alpha);
+      frame[i].g = blend_channel(layer->blend, frame[i].g, layer->led[i].g, alpha);
+      frame[i].b = blend_channel(layer->blend, frame[i].b, layer->led[i].b, alpha);
+      #ifdef RGBW
+        frame[i].w = blend_channel(layer->blend, frame[i].w, layer->led[i].w, alpha);
+      #endif
+    }
+  }
+}
+
+void rgblight_layer_changed(uint8_t layer) {
+  rgblight_mark_dirty(0, RGBLED_NUM - 1);
+}
+
+void rgblight_layer_changed_at(uint8_t layer, uint8_t index) {
+  if (index < RGBLED_NUM) {
+    rgblight_mark_dirty(index, index);
+  }
+}
+
+void rgblight_layer_setrgb_at(uint8_t layer, uint8_t r, uint8_t g, uint8_t b, uint8_t alpha, uint8_t index) {
+  rgblight_layer_t *l = &rgblight_layers[layer];
+  if (index >= RGBLED_NUM) {
+    return;
+  }
+  // indicators are set again on every led_set(), only a change is drawn
+  if (l->alpha[index] == alpha && l->led[index].r == r && l->led[index].g == g && l->led[index].b == b) {
+    return;
+  }
+  l->led[index].r = r;
+  l->led[index].g = g;
+  l->led[index].b = b;
+  l->alpha[index] = alpha;
+  rgblight_layer_changed_at(layer, index);
+}
+
+void rgblight_layer_clear(uint8_t layer) {
+  memset(rgblight_layers[layer].led, 0, sizeof(rgblight_layers[layer].led));
+  memset(rgblight_layers[layer].alpha, 0, sizeof(rgblight_layers[layer].alpha));
+  rgblight_layer_changed(layer);
+}
+
+void rgblight_layer_blend(uint8_t layer, uint8_t blend, uint8_t opacity) {
+  rgblight_layers[layer].blend = blend;
+  rgblight_layers[layer].opacity = opacity;
+  rgblight_layer_changed(layer);
+}
+#endif
+
+/* Sends led[], or with RGBLIGHT_LAYERS the merged frame, unless the strip
+ * already shows it. Within 1000 / RGBLIGHT_MAX_FPS ms of the last frame it is
+ * left for rgblight_task() to send later.
+ */
+static void rgblight_send(void) {
+#if RGBLIGHT_MAX_FPS
+  if (led_sent_valid && timer_elapsed(frame_timer) < 1000 / RGBLIGHT_MAX_FPS) {
+    frame_pending = true;
+    return;
+  }
+#endif
+  frame_pending = false;
+#ifdef RGBLIGHT_LAYERS
+  rgblight_compose();
+  LED_TYPE *out = frame;
+#else
+  LED_TYPE *out = led;
+#endif
+  if (led_sent_valid && !memcmp(led_sent, out, sizeof(led_sent))) {
+    return;
+  }
+#if RGBLIGHT_MAX_FPS
+  frame_timer = timer_read();
+#endif
+  memcpy(led_sent, out, sizeof(led_sent));
+  led_sent_valid = true;
+  #ifdef RGBW
+    ws2812_setleds_rgbw(out, RGBLED_NUM);
+  #else
+    ws2812_setleds(out, RGBLED_NUM);
+  #endif
+}
+
 __attribute__ ((weak))
 void rgblight_set(void) {
-  if (rgblight_config.enable) {
-    #ifdef RGBW
-      ws2812_setleds_rgbw(led, RGBLED_NUM);
-    #else
-      ws2812_setleds(led, RGBLED_NUM);
-    #endif
-  } else {
+  if (!rgblight_config.enable) {
     for (uint8_t i = 0; i < RGBLED_NUM; i++) {
       led[i].r = 0;
       led[i].g = 0;
       led[i].b = 0;
     }
-    #ifdef RGBW
-      ws2812_setleds_rgbw(led, RGBLED_NUM);
-    #else
-      ws2812_setleds(led, RGBLED_NUM);
-    #endif
   }
+#ifdef RGBLIGHT_LAYERS
+  // merged with the layers in rgblight_task()
+  rgblight_mark_dirty(0, RGBLED_NUM - 1);
+#else
+  rgblight_send();
+#endif
 }
 
+void rgblight_task(void) {
+  if (frame_pending) {
+    rgblight_send();
+  }
 #ifdef RGBLIGHT_ANIMATIONS
+  if (rgblight_timer_enabled) {
+    // mode = 1, static light, do nothing here
+    if (rgblight_config.mode >= 2 && rgblight_config.mode <= 5) {
+      // mode = 2 to 5, breathing mode
+      rgblight_effect_breathing(rgblight_config.mode - 2);
+    } else if (rgblight_config.mode >= 6 && rgblight_config.mode <= 8) {
+      // mode = 6 to 8, rainbow mood mod
+      rgblight_effect_rainbow_mood(rgblight_config.mode - 6);
+    } else if (rgblight_config.mode >= 9 && rgblight_config.mode <= 14) {
+      // mode = 9 to 14, rainbow swirl mode
+      rgblight_effect_rainbow_swirl(rgblight_config.mode - 9);
+    } else if (rgblight_config.mode >= 15 && rgblight_config.mode <= 20) {
+      // mode = 15 to 20, snake mode
+      rgblight_effect_snake(rgblight_config.mode - 15);
+    } else if (rgblight_config.mode >= 21 && rgblight_config.mode <= 23) {
+      // mode = 21 to 23, knight mode
+      rgblight_effect_knight(rgblight_config.mode - 21);
+    } else if (rgblight_config.mode == 24) {
+      // mode = 24, christmas mode
+      rgblight_effect_christmas();
+#ifdef RGBLIGHT_REACTIVE_ENABLE
+    } else if (rgblight_config.mode >= RGBLIGHT_REACTIVE_MODE) {
+      // mode = 35 to 37, reactive
+      rgblight_reactive_task(rgblight_config.mode - RGBLIGHT_REACTIVE_MODE);
+#endif
+    }
+  }
+#endif
+#if defined(RGBLIGHT_REACTIVE_ENABLE) && defined(RGBLIGHT_LAYERS) && defined(RGBLIGHT_REACTIVE_LAYER)
+  // the reactive layer over the other modes
+  if (rgblight_config.enable && rgblight_config.mode < RGBLIGHT_REACTIVE_MODE) {
+    rgblight_reactive_task(RGBLIGHT_REACTIVE_LAYER);
+  }
+#endif
+}
+
+#ifdef RGBLIGHT_ANIMATIONS
+
+// one clock for all effects, in ms since the mode started
+static uint32_t anim_start = 0;
+// when the step after the one drawn last starts
+static uint32_t anim_due = 0;
+
+/* Which of units equal steps of a period ms long cycle the animation is in.
+ * It is worked out from the clock rather than counted up per call, so a
+ * slow loop skips steps instead of slowing the animation down. false while
+ * the step drawn last is still current.
+ */
+static bool rgblight_anim_step(uint32_t period, uint16_t units, uint16_t *step) {
+  uint32_t elapsed = timer_elapsed32(anim_start);
+  if (elapsed < anim_due) {
+    return false;
+  }
+  uint32_t cycle = elapsed % period;
+  *step = cycle * units / period;
+  anim_due = elapsed - cycle + ((uint32_t)(*step + 1) * period + units - 1) / units;
+  return true;
+}
 
 // Animation timer -- AVR Timer3
 void rgblight_timer_init(void) {
@@ -442,6 +667,9 @@ void rgblight_timer_init(void) {
 }
 void rgblight_timer_enable(void) {
   rgblight_timer_enabled = true;
+  // every mode starts its animation from the beginning
+  anim_start = timer_read32();
+  anim_due = 0;
   dprintf("TIMER3 enabled.\n");
 }
 void rgblight_timer_disable(void) {
@@ -459,145 +687,101 @@ void rgblight_show_solid_color(uint8_t r, uint8_t g, uint8_t b) {
   rgblight_setrgb(r, g, b);
 }
 
-void rgblight_task(void) {
-  if (rgblight_timer_enabled) {
-    // mode = 1, static light, do nothing here
-    if (rgblight_config.mode >= 2 && rgblight_config.mode <= 5) {
-      // mode = 2 to 5, breathing mode
-      rgblight_effect_breathing(rgblight_config.mode - 2);
-    } else if (rgblight_config.mode >= 6 && rgblight_config.mode <= 8) {
-      // mode = 6 to 8, rainbow mood mod
-      rgblight_effect_rainbow_mood(rgblight_config.mode - 6);
-    } else if (rgblight_config.mode >= 9 && rgblight_config.mode <= 14) {
-      // mode = 9 to 14, rainbow swirl mode
-      rgblight_effect_rainbow_swirl(rgblight_config.mode - 9);
-    } else if (rgblight_config.mode >= 15 && rgblight_config.mode <= 20) {
-      // mode = 15 to 20, snake mode
-      rgblight_effect_snake(rgblight_config.mode - 15);
-    } else if (rgblight_config.mode >= 21 && rgblight_config.mode <= 23) {
-      // mode = 21 to 23, knight mode
-      rgblight_effect_knight(rgblight_config.mode - 21);
-    } else if (rgblight_config.mode == 24) {
-      // mode = 24, christmas mode
-      rgblight_effect_christmas();
-    }
-  }
-}
-
 // Effects
 void rgblight_effect_breathing(uint8_t interval) {
-  static uint8_t pos = 0;
-  static uint16_t last_timer = 0;
-
-  if (timer_elapsed(last_timer) < pgm_read_byte(&RGBLED_BREATHING_INTERVALS[interval])) {
+  uint16_t pos;
+  if (!rgblight_anim_step((uint32_t)256 * pgm_read_byte(&RGBLED_BREATHING_INTERVALS[interval]), 256, &pos)) {
     return;
   }
-  last_timer = timer_read();
-
   rgblight_sethsv_noeeprom(rgblight_config.hue, rgblight_config.sat, pgm_read_byte(&RGBLED_BREATHING_TABLE[pos]));
-  pos = (pos + 1) % 256;
 }
 void rgblight_effect_rainbow_mood(uint8_t interval) {
-  static uint16_t current_hue = 0;
-  static uint16_t last_timer = 0;
-
-  if (timer_elapsed(last_timer) < pgm_read_byte(&RGBLED_RAINBOW_MOOD_INTERVALS[interval])) {
+  uint16_t hue;
+  if (!rgblight_anim_step((uint32_t)360 * pgm_read_byte(&RGBLED_RAINBOW_MOOD_INTERVALS[interval]), 360, &hue)) {
     return;
   }
-  last_timer = timer_read();
-  rgblight_sethsv_noeeprom(current_hue, rgblight_config.sat, rgblight_config.val);
-  current_hue = (current_hue + 1) % 360;
+  rgblight_sethsv_noeeprom(hue, rgblight_config.sat, rgblight_config.val);
 }
 void rgblight_effect_rainbow_swirl(uint8_t interval) {
-  static uint16_t current_hue = 0;
-  static uint16_t last_timer = 0;
   uint16_t hue;
-  uint8_t i;
-  if (timer_elapsed(last_timer) < pgm_read_byte(&RGBLED_RAINBOW_MOOD_INTERVALS[interval / 2])) {
+  if (!rgblight_anim_step((uint32_t)360 * pgm_read_byte(&RGBLED_RAINBOW_MOOD_INTERVALS[interval / 2]), 360, &hue)) {
     return;
   }
-  last_timer = timer_read();
-  for (i = 0; i < RGBLED_NUM; i++) {
-    hue = (360 / RGBLED_NUM * i + current_hue) % 360;
-    sethsv(hue, rgblight_config.sat, rgblight_config.val, (LED_TYPE *)&led[i]);
+  if (!(interval % 2)) {
+    hue = (360 - hue) % 360;
   }
+  sethsv_leds(RGBLIGHT_HUE_FROM_DEGREES(hue), RGBLIGHT_HUE_FULL / RGBLED_NUM,
+              rgblight_config.sat, rgblight_config.val, led, RGBLED_NUM);
   rgblight_set();
-
-  if (interval % 2) {
-    current_hue = (current_hue + 1) % 360;
-  } else {
-    if (current_hue - 1 < 0) {
-      current_hue = 359;
-    } else {
-      current_hue = current_hue - 1;
-    }
-  }
 }
 void rgblight_effect_snake(uint8_t interval) {
-  static uint8_t pos = 0;
-  static uint16_t last_timer = 0;
+  uint16_t pos;
   uint8_t i, j;
   int8_t k;
+  uint16_t hue;
   int8_t increment = 1;
   if (interval % 2) {
     increment = -1;
   }
-  if (timer_elapsed(last_timer) < pgm_read_byte(&RGBLED_SNAKE_INTERVALS[interval / 2])) {
+  if (!rgblight_anim_step((uint32_t)RGBLED_NUM * pgm_read_byte(&RGBLED_SNAKE_INTERVALS[interval / 2]), RGBLED_NUM, &pos)) {
     return;
   }
-  last_timer = timer_read();
+  if (increment == 1) {
+    // runs down the strip, the tail above it
+    pos = (RGBLED_NUM - pos) % RGBLED_NUM;
+  }
   for (i = 0; i < RGBLED_NUM; i++) {
     led[i].r = 0;
     led[i].g = 0;
     led[i].b = 0;
-    for (j = 0; j < RGBLIGHT_EFFECT_SNAKE_LENGTH; j++) {
-      k = pos + j * increment;
-      if (k < 0) {
-        k = k + RGBLED_NUM;
-      }
-      if (i == k) {
-        sethsv(rgblight_config.hue, rgblight_config.sat, (uint8_t)(rgblight_config.val*(RGBLIGHT_EFFECT_SNAKE_LENGTH-j)/RGBLIGHT_EFFECT_SNAKE_LENGTH), (LED_TYPE *)&led[i]);
-      }
-    }
   }
-  rgblight_set();
-  if (increment == 1) {
-    if (pos - 1 < 0) {
-      pos = RGBLED_NUM - 1;
-    } else {
-      pos -= 1;
+  hue = RGBLIGHT_HUE_FROM_DEGREES(rgblight_config.hue);
+  for (j = 0; j < RGBLIGHT_EFFECT_SNAKE_LENGTH; j++) {
+    k = pos + j * increment;
+    if (k < 0) {
+      k = k + RGBLED_NUM;
+    }
+    if (k >= 0 && k < RGBLED_NUM) {
+      sethsv_leds(hue, 0, rgblight_config.sat, (uint8_t)(rgblight_config.val*(RGBLIGHT_EFFECT_SNAKE_LENGTH-j)/RGBLIGHT_EFFECT_SNAKE_LENGTH), (LED_TYPE *)&led[k], 1);
     }
-  } else {
-    pos = (pos + 1) % RGBLED_NUM;
   }
+  rgblight_set();
 }
 void rgblight_effect_knight(uint8_t interval) {
-  static int8_t pos = 0;
-  static uint16_t last_timer = 0;
+  // moves from one end to the other, the lit part fully off the strip at both
+  const int16_t span = RGBLED_NUM + 2 * RGBLIGHT_EFFECT_KNIGHT_LENGTH - 1;
+  uint16_t step;
+  int16_t pos;
   uint8_t i, j, cur;
-  int8_t k;
+  int16_t k;
   LED_TYPE preled[RGBLED_NUM];
-  static int8_t increment = -1;
-  if (timer_elapsed(last_timer) < pgm_read_byte(&RGBLED_KNIGHT_INTERVALS[interval])) {
+  LED_TYPE lit = {0};
+  int8_t increment;
+  if (!rgblight_anim_step((uint32_t)2 * span * pgm_read_byte(&RGBLED_KNIGHT_INTERVALS[interval]), 2 * span, &step)) {
     return;
   }
-  last_timer = timer_read();
+  if (step < span) {
+    pos = step - RGBLIGHT_EFFECT_KNIGHT_LENGTH;
+    increment = -1;
+  } else {
+    pos = RGBLED_NUM + RGBLIGHT_EFFECT_KNIGHT_LENGTH - 1 - (step - span);
+    increment = 1;
+  }
   for (i = 0; i < RGBLED_NUM; i++) {
     preled[i].r = 0;
     preled[i].g = 0;
     preled[i].b = 0;
-    for (j = 0; j < RGBLIGHT_EFFECT_KNIGHT_LENGTH; j++) {
-      k = pos + j * increment;
-      if (k < 0) {
-        k = 0;
-      }
-      if (k >= RGBLED_NUM) {
-        k = RGBLED_NUM - 1;
-      }
-      if (i == k) {
-        sethsv(rgblight_config.hue, rgblight_config.sat, rgblight_config.val, (LED_TYPE *)&preled[i]);
-      }
+  }
+  sethsv(rgblight_config.hue, rgblight_config.sat, rgblight_config.val, &lit);
+  for (j = 0; j < RGBLIGHT_EFFECT_KNIGHT_LENGTH; j++) {
+    k = pos + j * increment;
+    if (k < 0) {
+      k = 0;
+    }
+    if (k >= RGBLED_NUM) {
+      k = RGBLED_NUM - 1;
     }
+    preled[k] = lit;
   }
   if (RGBLIGHT_EFFECT_KNIGHT_OFFSET) {
     for (i = 0; i < RGBLED_NUM; i++) {
@@ -608,37 +792,20 @@ void rgblight_effect_knight(uint8_t interval) {
     }
   }
   rgblight_set();
-  if (increment == 1) {
-    if (pos - 1 < 0 - RGBLIGHT_EFFECT_KNIGHT_LENGTH) {
-      pos = 0 - RGBLIGHT_EFFECT_KNIGHT_LENGTH;
-      increment = -1;
-    } else {
-      pos -= 1;
-    }
-  } else {
-    if (pos + 1 > RGBLED_NUM + RGBLIGHT_EFFECT_KNIGHT_LENGTH) {
-      pos = RGBLED_NUM + RGBLIGHT_EFFECT_KNIGHT_LENGTH - 1;
-      increment = 1;
-    } else {
-      pos += 1;
-    }
-  }
 }
 
 
 void rgblight_effect_christmas(void) {
-  static uint16_t current_offset = 0;
-  static uint16_t last_timer = 0;
-  uint16_t hue;
+  uint16_t current_offset;
+  LED_TYPE colors[2] = {{0}};
   uint8_t i;
-  if (timer_elapsed(last_timer) < RGBLIGHT_EFFECT_CHRISTMAS_INTERVAL) {
+  if (!rgblight_anim_step(2 * (uint32_t)RGBLIGHT_EFFECT_CHRISTMAS_INTERVAL, 2, &current_offset)) {
     return;
   }
-  last_timer = timer_read();
-  current_offset = (current_offset + 1) % 2;
+  // red and green
+  sethsv_leds(0, RGBLIGHT_HUE_FROM_DEGREES(120), rgblight_config.sat, rgblight_config.val, colors, 2);
   for (i = 0; i < RGBLED_NUM; i++) {
-    hue = 0 + ((i/RGBLIGHT_EFFECT_CHRISTMAS_STEP + current_offset) % 2) * 120;
-    sethsv(hue, rgblight_config.sat, rgblight_config.val, (LED_TYPE *)&led[i]);
+    led[i] = colors[(i/RGBLIGHT_EFFECT_CHRISTMAS_STEP + current_offset) % 2];
   }
   rgblight_set();
 }
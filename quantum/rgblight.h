@@ -1,7 +1,13 @@
 #ifndef RGBLIGHT_H
 #define RGBLIGHT_H
 
-#ifdef RGBLIGHT_ANIMATIONS
+#if defined(RGBLIGHT_REACTIVE_ENABLE)
+	#ifndef RGBLIGHT_ANIMATIONS
+		#error "RGBLIGHT_REACTIVE_ENABLE needs RGBLIGHT_ANIMATIONS"
+	#endif
+	#define RGBLIGHT_REACTIVE_MODE 35
+	#define RGBLIGHT_MODES 37
+#elif defined(RGBLIGHT_ANIMATIONS)
 	#define RGBLIGHT_MODES 34
 #else
 	#define RGBLIGHT_MODES 1
@@ -30,6 +36,11 @@
 #define RGBLIGHT_EFFECT_CHRISTMAS_STEP 2
 #endif
 
+// frames per second sent to the strip at most, 0 for no limit
+#ifndef RGBLIGHT_MAX_FPS
+#define RGBLIGHT_MAX_FPS 0
+#endif
+
 #ifndef RGBLIGHT_HUE_STEP
 #define RGBLIGHT_HUE_STEP 10
 #endif
@@ -40,6 +51,10 @@
 #define RGBLIGHT_VAL_STEP 17
 #endif
 
+// fixed point hue: 256 steps per 60 degrees, the sextant in the high byte
+#define RGBLIGHT_HUE_FULL 1536
+#define RGBLIGHT_HUE_FROM_DEGREES(deg) ((uint16_t)(((uint32_t)(deg) * 4369 + 512) >> 10))
+
 #define RGBLED_TIMER_TOP F_CPU/(256*64)
 // #define RGBLED_TIMER_TOP 0xFF10
 
@@ -50,6 +65,44 @@
 
 extern LED_TYPE led[RGBLED_NUM];
 
+#ifdef RGBLIGHT_LAYERS
+/*
+ * The modes draw the base layer, led[]. The layers above it are blended on
+ * top in order, each with its own alpha per LED and a blend mode and opacity
+ * for the whole layer. Only the LEDs that changed in led[] or a layer are
+ * merged again, at most once per rgblight_task(), and the overlay stays lit
+ * when rgblight is off.
+ */
+enum rgblight_layer {
+  RGBLIGHT_LAYER_REACTIVE,
+  RGBLIGHT_LAYER_OVERLAY,   // layer and lock indicators
+  RGBLIGHT_LAYER_COUNT
+};
+
+enum rgblight_blend {
+  RGBLIGHT_BLEND_NORMAL,
+  RGBLIGHT_BLEND_ADD,
+  RGBLIGHT_BLEND_MULTIPLY,
+  RGBLIGHT_BLEND_LIGHTEN
+};
+
+typedef struct {
+  LED_TYPE led[RGBLED_NUM];
+  uint8_t alpha[RGBLED_NUM];  // 0 shows the layers below
+  uint8_t blend;
+  uint8_t opacity;
+} rgblight_layer_t;
+
+extern rgblight_layer_t rgblight_layers[RGBLIGHT_LAYER_COUNT];
+
+void rgblight_layer_setrgb_at(uint8_t layer, uint8_t r, uint8_t g, uint8_t b, uint8_t alpha, uint8_t index);
+void rgblight_layer_clear(uint8_t layer);
+void rgblight_layer_blend(uint8_t layer, uint8_t blend, uint8_t opacity);
+/* after writing rgblight_layers[layer] directly, all of it or one LED */
+void rgblight_layer_changed(uint8_t layer);
+void rgblight_layer_changed_at(uint8_t layer, uint8_t index);
+#endif
+
 extern const uint8_t RGBLED_BREATHING_INTERVALS[4] PROGMEM;
 extern const uint8_t RGBLED_RAINBOW_MOOD_INTERVALS[3] PROGMEM;
 extern const uint8_t RGBLED_RAINBOW_SWIRL_INTERVALS[3] PROGMEM;
@@ -91,7 +144,10 @@ void eeconfig_update_rgblight(uint32_t val);
 void eeconfig_update_rgblight_default(void);
 void eeconfig_debug_rgblight(void);
 
+/* hue in degrees */
 void sethsv(uint16_t hue, uint8_t sat, uint8_t val, LED_TYPE *led1);
+/* count LEDs from hue on, hue_step apart, hue in RGBLIGHT_HUE_FULL units */
+void sethsv_leds(uint16_t hue, int16_t hue_step, uint8_t sat, uint8_t val, LED_TYPE *leds, uint8_t count);
 void setrgb(uint8_t r, uint8_t g, uint8_t b, LED_TYPE *led1);
 void rgblight_sethsv_noeeprom(uint16_t hue, uint8_t sat, uint8_t val);
 
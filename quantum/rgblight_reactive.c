@@ -0,0 +1,182 @@
+#include <string.h>
+#include "timer.h"
+#include "rgblight.h"
+#include "rgblight_reactive.h"
+
+extern rgblight_config_t rgblight_config;
+
+// farthest two points on the board are apart by the distance() measure
+#define RIPPLE_REACH (255 + 255 / 2 + RGBLIGHT_REACTIVE_RIPPLE_WIDTH)
+
+typedef struct {
+    uint8_t x;
+    uint8_t y;
+    uint16_t start;
+    bool live;
+} ripple_t;
+
+uint16_t rgblight_reactive_drops = 0;
+
+static keypos_t events[RGBLIGHT_REACTIVE_EVENTS];
+static uint8_t event_head = 0;
+static uint8_t event_count = 0;
+
+// brightness for fade, heat for the heatmap
+static uint8_t level[RGBLED_NUM];
+static ripple_t ripples[RGBLIGHT_REACTIVE_RIPPLES];
+static uint8_t ripple_next = 0;
+
+static uint16_t frame_timer = 0;
+static uint8_t cool_frames = 0;
+static bool active = false;
+
+static uint8_t scale8(uint8_t a, uint8_t b) {
+  return ((uint16_t)a * b + a) >> 8;
+}
+
+// octagonal approximation of the distance, no square root
+static uint8_t distance(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2) {
+  uint8_t dx = x1 > x2 ? x1 - x2 : x2 - x1;
+  uint8_t dy = y1 > y2 ? y1 - y2 : y2 - y1;
+  uint16_t d = dx > dy ? dx + (dy >> 1) : dy + (dx >> 1);
+  return d > 255 ? 255 : d;
+}
+
+// whether rgblight_task() runs an effect, otherwise nothing drains the ring
+static bool running(void) {
+  if (!rgblight_config.enable) return false;
+#if defined(RGBLIGHT_LAYERS) && defined(RGBLIGHT_REACTIVE_LAYER)
+  return true;
+#else
+  return rgblight_config.mode >= RGBLIGHT_REACTIVE_MODE;
+#endif
+}
+
+void rgblight_reactive_record(keypos_t key, bool pressed) {
+  if (!pressed || !running()) return;
+  if (event_count == RGBLIGHT_REACTIVE_EVENTS) {
+    rgblight_reactive_drops++;
+    return;
+  }
+  events[(event_head + event_count) % RGBLIGHT_REACTIVE_EVENTS] = key;
+  event_count++;
+}
+
+void rgblight_reactive_clear(void) {
+  event_count = 0;
+  memset(level, 0, sizeof(level));
+  memset(ripples, 0, sizeof(ripples));
+  active = true;  // draw once to clear the strip
+}
+
+static void take_events(uint8_t effect, uint16_t now) {
+  for (; event_count; event_count--) {
+    keypos_t key = events[event_head];
+    event_head = (event_head + 1) % RGBLIGHT_REACTIVE_EVENTS;
+
+    const rgblight_key_led_t *map = &rgblight_key_leds[key.row][key.col];
+    uint8_t index = pgm_read_byte(&map->led);
+    if (index >= RGBLED_NUM) continue;
+
+    switch (effect) {
+      case RGBLIGHT_REACTIVE_FADE:
+        level[index] = 255;
+        break;
+      case RGBLIGHT_REACTIVE_RIPPLE:
+        ripples[ripple_next] = (ripple_t){
+          .x = pgm_read_byte(&map->x), .y = pgm_read_byte(&map->y), .start = now, .live = true
+        };
+        ripple_next = (ripple_next + 1) % RGBLIGHT_REACTIVE_RIPPLES;
+        break;
+      case RGBLIGHT_REACTIVE_HEATMAP:
+        level[index] = level[index] > 255 - RGBLIGHT_REACTIVE_HEAT_STEP ? 255 : level[index] + RGBLIGHT_REACTIVE_HEAT_STEP;
+        break;
+    }
+    active = true;
+  }
+}
+
+static uint8_t ripple_brightness(uint8_t x, uint8_t y, const uint16_t *radius) {
+  uint8_t brightness = 0;
+  for (uint8_t i = 0; i < RGBLIGHT_REACTIVE_RIPPLES; i++) {
+    if (!ripples[i].live) continue;
+    uint8_t d = distance(x, y, ripples[i].x, ripples[i].y);
+    uint16_t off = d > radius[i] ? d - radius[i] : radius[i] - d;
+    if (off >= RGBLIGHT_REACTIVE_RIPPLE_WIDTH) continue;
+    uint8_t b = 255 - off * (256 / RGBLIGHT_REACTIVE_RIPPLE_WIDTH);
+    if (b > brightness) brightness = b;
+  }
+  return brightness;
+}
+
+void rgblight_reactive_task(uint8_t effect) {
+  if (timer_elapsed(frame_timer) < 1000 / RGBLIGHT_REACTIVE_FPS) return;
+  frame_timer = timer_read();
+
+  take_events(effect, frame_timer);
+  // nothing lit and nothing new, the last frame still stands
+  if (!active) return;
+  active = false;
+
+  uint16_t hue = RGBLIGHT_HUE_FROM_DEGREES(rgblight_config.hue);
+  uint16_t radius[RGBLIGHT_REACTIVE_RIPPLES];
+  if (effect == RGBLIGHT_REACTIVE_RIPPLE) {
+    for (uint8_t i = 0; i < RGBLIGHT_REACTIVE_RIPPLES; i++) {
+      uint32_t r = (uint32_t)timer_elapsed(ripples[i].start) * RGBLIGHT_REACTIVE_RIPPLE_SPEED / 1000;
+      radius[i] = r > RIPPLE_REACH ? RIPPLE_REACH : r;
+      if (radius[i] == RIPPLE_REACH) ripples[i].live = false;
+      if (ripples[i].live) active = true;
+    }
+  }
+  bool cool = effect == RGBLIGHT_REACTIVE_HEATMAP && ++cool_frames >= RGBLIGHT_REACTIVE_COOL_FRAMES;
+  if (cool) cool_frames = 0;
+
+#ifdef RGBLIGHT_LAYERS
+  LED_TYPE *out = rgblight_layers[RGBLIGHT_LAYER_REACTIVE].led;
+#else
+  LED_TYPE *out = led;
+#endif
+  memset(out, 0, sizeof(led));
+  for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+    for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+      const rgblight_key_led_t *map = &rgblight_key_leds[row][col];
+      uint8_t index = pgm_read_byte(&map->led);
+      if (index >= RGBLED_NUM) continue;
+
+      switch (effect) {
+        case RGBLIGHT_REACTIVE_FADE:
+          if (!level[index]) break;
+          sethsv_leds(hue, 0, rgblight_config.sat, scale8(rgblight_config.val, level[index]), &out[index], 1);
+          level[index] = level[index] > RGBLIGHT_REACTIVE_FADE_STEP ? level[index] - RGBLIGHT_REACTIVE_FADE_STEP : 0;
+          active = true;
+          break;
+        case RGBLIGHT_REACTIVE_RIPPLE: {
+          uint8_t b = ripple_brightness(pgm_read_byte(&map->x), pgm_read_byte(&map->y), radius);
+          if (b) sethsv_leds(hue, 0, rgblight_config.sat, scale8(rgblight_config.val, b), &out[index], 1);
+          break;
+        }
+        case RGBLIGHT_REACTIVE_HEATMAP:
+          if (!level[index]) break;
+          // 240 degrees, blue, when cold to 0, red, when hot
+          sethsv_leds(RGBLIGHT_HUE_FROM_DEGREES(240) - (uint32_t)RGBLIGHT_HUE_FROM_DEGREES(240) * level[index] / 255,
+                      0, rgblight_config.sat, rgblight_config.val, &out[index], 1);
+          if (cool) level[index]--;
+          active = true;
+          break;
+      }
+    }
+  }
+#ifdef RGBLIGHT_LAYERS
+  // unlit LEDs show the layers below, only LEDs lit now or before changed
+  uint8_t *alpha = rgblight_layers[RGBLIGHT_LAYER_REACTIVE].alpha;
+  for (uint8_t i = 0; i < RGBLED_NUM; i++) {
+    uint8_t a = (out[i].r | out[i].g | out[i].b) ? 255 : 0;
+    if (a || alpha[i]) {
+      rgblight_layer_changed_at(RGBLIGHT_LAYER_REACTIVE, i);
+    }
+    alpha[i] = a;
+  }
+#else
+  rgblight_set();
+#endif
+}
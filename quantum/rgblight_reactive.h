@@ -0,0 +1,94 @@
+#ifndef RGBLIGHT_REACTIVE_H
+#define RGBLIGHT_REACTIVE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "keyboard.h"
+#include "progmem.h"
+
+/*
+ * Per-key reactive lighting
+ *
+ * rgblight modes RGBLIGHT_REACTIVE_MODE and on light the keys that are
+ * pressed: fade, ripple and heatmap. The keyboard maps every key to the LED
+ * under it and to where it is on the board:
+ *
+ *     const rgblight_key_led_t PROGMEM rgblight_key_leds[MATRIX_ROWS][MATRIX_COLS] = {
+ *         { KEY_LED(0, 0, 0), KEY_LED(1, 18, 0), ... },
+ *         ...
+ *     };
+ *
+ * x and y run from 0 to 255 across the board, keys without an LED are
+ * KEY_NO_LED, an entry left out is LED 0. LEDs that aren't under a key stay
+ * dark. The colour is the hue and saturation of rgblight, the heatmap goes
+ * from blue to red.
+ *
+ * With RGBLIGHT_LAYERS the effects draw on RGBLIGHT_LAYER_REACTIVE, and
+ * RGBLIGHT_REACTIVE_LAYER, say RGBLIGHT_REACTIVE_RIPPLE, runs that effect
+ * over the other modes as well.
+ *
+ * Presses only go into a small ring, the effects catch up with it when the
+ * next frame is drawn. A full ring drops presses, rgblight_reactive_drops
+ * counts them.
+ */
+
+#ifndef RGBLIGHT_REACTIVE_FPS
+#define RGBLIGHT_REACTIVE_FPS 30
+#endif
+
+#ifndef RGBLIGHT_REACTIVE_EVENTS
+#define RGBLIGHT_REACTIVE_EVENTS 8
+#endif
+
+// brightness lost per frame after a press, out of 255
+#ifndef RGBLIGHT_REACTIVE_FADE_STEP
+#define RGBLIGHT_REACTIVE_FADE_STEP 12
+#endif
+
+// board widths per second and width of the ring, in x/y units
+#ifndef RGBLIGHT_REACTIVE_RIPPLE_SPEED
+#define RGBLIGHT_REACTIVE_RIPPLE_SPEED 384
+#endif
+#ifndef RGBLIGHT_REACTIVE_RIPPLE_WIDTH
+#define RGBLIGHT_REACTIVE_RIPPLE_WIDTH 32
+#endif
+#ifndef RGBLIGHT_REACTIVE_RIPPLES
+#define RGBLIGHT_REACTIVE_RIPPLES 4
+#endif
+
+// heat a press adds, and frames between each step of cooling
+#ifndef RGBLIGHT_REACTIVE_HEAT_STEP
+#define RGBLIGHT_REACTIVE_HEAT_STEP 32
+#endif
+#ifndef RGBLIGHT_REACTIVE_COOL_FRAMES
+#define RGBLIGHT_REACTIVE_COOL_FRAMES 4
+#endif
+
+enum rgblight_reactive_effect {
+    RGBLIGHT_REACTIVE_FADE,
+    RGBLIGHT_REACTIVE_RIPPLE,
+    RGBLIGHT_REACTIVE_HEATMAP,
+    RGBLIGHT_REACTIVE_EFFECTS
+};
+
+typedef struct {
+    uint8_t led;
+    uint8_t x;
+    uint8_t y;
+} rgblight_key_led_t;
+
+#define RGBLIGHT_NO_LED 0xFF
+#define KEY_LED(led, x, y) { led, x, y }
+#define KEY_NO_LED { RGBLIGHT_NO_LED, 0, 0 }
+
+extern const rgblight_key_led_t PROGMEM rgblight_key_leds[MATRIX_ROWS][MATRIX_COLS];
+
+extern uint16_t rgblight_reactive_drops;
+
+/* called for every key event, only queues presses while an effect runs */
+void rgblight_reactive_record(keypos_t key, bool pressed);
+/* draws a frame into led[] when one is due */
+void rgblight_reactive_task(uint8_t effect);
+void rgblight_reactive_clear(void);
+
+#endif
@@ -20,3 +20,10 @@ serial_link_transport_SRC := \
 	$(SERIAL_PATH)/tests/transport_tests.cpp \
 	$(SERIAL_PATH)/protocol/transport.c \
 	$(SERIAL_PATH)/protocol/triple_buffered_object.c 
+
+serial_link_bench_SRC := \
+	$(SERIAL_PATH)/tests/serial_link_bench.c \
+	$(TMK_PATH)/common/tests/bench.c \
+	$(SERIAL_PATH)/protocol/byte_stuffer.c \
+	$(SERIAL_PATH)/protocol/frame_validator.c
+serial_link_bench_INC := $(TMK_PATH)/common/tests
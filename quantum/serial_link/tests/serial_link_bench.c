@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <string.h>
+#include "serial_link/protocol/byte_stuffer.h"
+#include "serial_link/protocol/frame_validator.h"
+#include "serial_link/protocol/frame_router.h"
+#include "serial_link/protocol/physical.h"
+#include "bench.h"
+
+/* Frames go out through the frame validator and the byte stuffer into a
+ * loopback buffer, which is fed back byte by byte to the receiving side.
+ */
+
+#define FRAME_SIZE 32
+
+static uint8_t wire[2 * MAX_FRAME_SIZE];
+static uint16_t wire_size;
+static uint32_t frames_received;
+
+void send_data(uint8_t link, const uint8_t* data, uint16_t size)
+{
+    (void)link;
+    if (wire_size + size > sizeof(wire)) wire_size = 0;
+    memcpy(wire + wire_size, data, size);
+    wire_size += size;
+}
+
+void route_incoming_frame(uint8_t link, uint8_t* data, uint16_t size)
+{
+    (void)link; (void)data; (void)size;
+    frames_received++;
+}
+
+/* room for the crc validator_send_frame() appends */
+static uint8_t frame[FRAME_SIZE + 4];
+
+static void reset(void)
+{
+    init_byte_stuffer();
+    wire_size = 0;
+    for (int i = 0; i < FRAME_SIZE; i++) {
+        frame[i] = i % 7 ? i : 0;   // some zeros for the byte stuffer
+    }
+}
+
+static void bench_byte_stuffer_send(void)
+{
+    wire_size = 0;
+    byte_stuffer_send_frame(0, frame, FRAME_SIZE);
+}
+
+static void bench_validator_send(void)
+{
+    wire_size = 0;
+    validator_send_frame(0, frame, FRAME_SIZE);
+}
+
+static void bench_roundtrip(void)
+{
+    wire_size = 0;
+    validator_send_frame(0, frame, FRAME_SIZE);
+    for (uint16_t i = 0; i < wire_size; i++) {
+        byte_stuffer_recv_byte(0, wire[i]);
+    }
+}
+
+static const bench_t benches[] = {
+    BENCH(byte_stuffer_send, reset),
+    BENCH(validator_send, reset),
+    BENCH(roundtrip, reset),
+};
+
+int main(int argc, char **argv)
+{
+    int result = bench_main(argc, argv, benches, sizeof(benches) / sizeof(benches[0]));
+    printf("%lu frames received\n", (unsigned long)frames_received);
+    return result;
+}
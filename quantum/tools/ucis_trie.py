@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+#
+# Generates a PROGMEM prefix tree for UCIS from the UCIS_SYM() entries of a
+# keymap, so process_ucis can look symbols up one keypress at a time.
+#
+# Usage: ucis_trie.py keymap.c > ucis_trie.h
+#
+# Then #include "ucis_trie.h" from the keymap and #define UCIS_TRIE in its
+# config.h. Regenerate whenever the symbol table changes.
+
+import re
+import sys
+
+KC_A = 0x04
+KC_1 = 0x1E
+KC_0 = 0x27
+
+TERMINAL = 0x80
+MAX_CHILDREN = 0x7F
+
+SYM_RE = re.compile(r'UCIS_SYM\s*\(\s*"([^"]*)"\s*,\s*(0[xX][0-9a-fA-F]+|[0-9]+)\s*\)')
+
+
+def to_keycodes(name):
+    keycodes = []
+    for c in name:
+        if 'a' <= c <= 'z':
+            keycodes.append(KC_A + ord(c) - ord('a'))
+        elif c == '0':
+            keycodes.append(KC_0)
+        elif '1' <= c <= '9':
+            keycodes.append(KC_1 + ord(c) - ord('1'))
+        else:
+            raise ValueError('unsupported character %r in UCIS symbol "%s"' % (c, name))
+    return tuple(keycodes)
+
+
+def build(symbols):
+    """Serialises the trie depth first.
+
+    Each node is lo(2) hi(2) flags|children(1) followed by one
+    keycode(1) offset(2) edge per child, sorted by keycode. [lo, hi) is the
+    range of sorted symbols that share the node's prefix, and TERMINAL is
+    set when symbol lo ends at the node.
+    """
+    out = bytearray()
+
+    def node(lo, hi, depth):
+        start = len(out)
+        terminal = len(symbols[lo][0]) == depth
+        first = lo + 1 if terminal else lo
+
+        children = []
+        i = first
+        while i < hi:
+            kc = symbols[i][0][depth]
+            j = i
+            while j < hi and symbols[j][0][depth] == kc:
+                j += 1
+            children.append((kc, i, j))
+            i = j
+        if len(children) > MAX_CHILDREN:
+            raise ValueError('too many branches in UCIS trie')
+
+        out.extend([lo >> 8, lo & 0xFF, hi >> 8, hi & 0xFF,
+                    (TERMINAL if terminal else 0) | len(children)])
+        edges = len(out)
+        out.extend(bytes(3 * len(children)))
+
+        for n, (kc, clo, chi) in enumerate(children):
+            offset = node(clo, chi, depth + 1)
+            out[edges + 3 * n:edges + 3 * n + 3] = bytes([kc, offset >> 8, offset & 0xFF])
+        return start
+
+    node(0, len(symbols), 0)
+    if len(out) > 0xFFFF:
+        raise ValueError('UCIS trie does not fit 16 bit offsets')
+    return out
+
+
+def main(argv):
+    if len(argv) != 2:
+        sys.stderr.write('usage: %s keymap.c > ucis_trie.h\n' % argv[0])
+        return 1
+
+    with open(argv[1]) as f:
+        source = f.read()
+
+    symbols = {}
+    for name, code in SYM_RE.findall(source):
+        keycodes = to_keycodes(name)
+        if not keycodes:
+            raise ValueError('empty UCIS symbol')
+        if keycodes in symbols:
+            raise ValueError('duplicate UCIS symbol "%s"' % name)
+        symbols[keycodes] = (name, int(code, 0))
+
+    if not symbols:
+        sys.stderr.write('no UCIS_SYM entries found in %s\n' % argv[1])
+        return 1
+
+    ordered = sorted((k, v[0], v[1]) for k, v in symbols.items())
+    trie = build(ordered)
+
+    print('/* Generated by quantum/tools/ucis_trie.py from %s, do not edit. */' % argv[1])
+    print('#ifndef UCIS_TRIE_H')
+    print('#define UCIS_TRIE_H')
+    print('')
+    print('const uint32_t PROGMEM ucis_trie_codes[] = {')
+    for _, name, code in ordered:
+        print('  0x%05x, // %s' % (code, name))
+    print('};')
+    print('')
+    print('const uint8_t PROGMEM ucis_trie[] = {')
+    for i in range(0, len(trie), 12):
+        print('  ' + ' '.join('0x%02x,' % b for b in trie[i:i + 12]))
+    print('};')
+    print('')
+    print('#endif')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
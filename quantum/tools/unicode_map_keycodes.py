@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+#
+# Precomputes the hex digit keycodes typed for every unicode_map[] entry,
+# so process_unicode_map only has to copy them into the typing queue.
+#
+# Usage: unicode_map_keycodes.py keymap.c > unicode_map_keycodes.h
+#
+# Then #include "unicode_map_keycodes.h" from the keymap after unicode_map[]
+# and #define UNICODEMAP_KEYCODES in its config.h. The digits use the
+# default hex_to_keycode() mapping, so don't use this together with an
+# overridden hex_to_keycode(). Regenerate whenever unicode_map[] changes.
+
+import re
+import sys
+
+SEQUENCE_LENGTH = 8
+
+KC_A = 0x04
+KC_1 = 0x1E
+KC_0 = 0x27
+
+
+def hex_to_keycode(digit):
+    if digit == 0:
+        return KC_0
+    if digit < 0xA:
+        return KC_1 + digit - 1
+    return KC_A + digit - 0xA
+
+
+def hex_keycodes(value, min_digits=4):
+    digits = '%0*x' % (min_digits, value)
+    return [hex_to_keycode(int(d, 16)) for d in digits]
+
+
+def sequences(code):
+    """Returns the (generic, osx) keycode sequences for a code point.
+
+    The generic one is what UC_LNX, UC_WIN and UC_WINC type, OS X needs
+    exactly four digits per UTF-16 unit. An empty sequence means the mode
+    can't enter the code point.
+    """
+    generic = hex_keycodes(code)
+    if len(generic) > SEQUENCE_LENGTH:
+        generic = []
+
+    if code > 0x10FFFF:
+        osx = []
+    elif code > 0xFFFF:
+        code -= 0x10000
+        osx = hex_keycodes(0xD800 + (code >> 10)) + hex_keycodes(0xDC00 + (code & 0x3FF))
+    else:
+        osx = generic
+    return generic, osx
+
+
+def split_entries(body):
+    body = re.sub(r'/\*.*?\*/', '', body, flags=re.S)
+    body = re.sub(r'//[^\n]*', '', body)
+    return [e.strip() for e in body.split(',') if e.strip()]
+
+
+def parse_unicode_map(source):
+    match = re.search(r'unicode_map\s*\[\s*\]\s*=\s*\{(.*?)\}\s*;', source, re.S)
+    if not match:
+        raise ValueError('no unicode_map[] found')
+
+    entries = []
+    for entry in split_entries(match.group(1)):
+        designated = re.match(r'^\[(.+)\]\s*=\s*(.+)$', entry)
+        if designated:
+            index, value = designated.group(1).strip(), designated.group(2).strip()
+        else:
+            index, value = None, entry
+        try:
+            code = int(value, 0)
+        except ValueError:
+            raise ValueError('unicode_map[] entry "%s" is not a number' % entry)
+        entries.append((index, code))
+    return entries
+
+
+def format_row(index, keycodes, code):
+    row = ', '.join('0x%02x' % kc for kc in keycodes) or '0'
+    if index is None:
+        return '  {%s}, // U+%04X' % (row, code)
+    return '  [%s] = {%s}, // U+%04X' % (index, row, code)
+
+
+def main(argv):
+    if len(argv) != 2:
+        sys.stderr.write('usage: %s keymap.c > unicode_map_keycodes.h\n' % argv[0])
+        return 1
+
+    with open(argv[1]) as f:
+        entries = parse_unicode_map(f.read())
+
+    rows = [(index, code) + sequences(code) for index, code in entries]
+
+    print('/* Generated by quantum/tools/unicode_map_keycodes.py from %s, do not edit. */' % argv[1])
+    print('#ifndef UNICODE_MAP_KEYCODES_H')
+    print('#define UNICODE_MAP_KEYCODES_H')
+    print('')
+    print('const uint8_t PROGMEM unicode_map_keycodes[][UNICODEMAP_SEQUENCE_LENGTH] = {')
+    for index, code, generic, _ in rows:
+        print(format_row(index, generic, code))
+    print('};')
+    print('')
+    print('const uint8_t PROGMEM unicode_map_keycodes_osx[][UNICODEMAP_SEQUENCE_LENGTH] = {')
+    for index, code, _, osx in rows:
+        print(format_row(index, osx, code))
+    print('};')
+    print('')
+    print('#endif')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
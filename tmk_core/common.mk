@@ -117,6 +117,28 @@ ifeq ($(strip $(KEYMAP_SECTION_ENABLE)), yes)
     endif
 endif
 
+ifeq ($(strip $(TRACE_ENABLE)), yes)
+    TMK_COMMON_SRC += $(COMMON_DIR)/trace.c
+    TMK_COMMON_DEFS += -DTRACE_ENABLE
+    TMK_COMMON_LDFLAGS += -Wl,-T,$(TMK_PATH)/ldscript_trace.x
+endif
+
+ifeq ($(strip $(LATENCY_PROFILE_ENABLE)), yes)
+    TMK_COMMON_SRC += $(COMMON_DIR)/latency.c
+    TMK_COMMON_DEFS += -DLATENCY_PROFILE_ENABLE
+endif
+
+ifeq ($(strip $(SAMPLE_PROFILE_ENABLE)), yes)
+    TMK_COMMON_SRC += $(COMMON_DIR)/profile.c
+    TMK_COMMON_SRC += $(PLATFORM_COMMON_DIR)/profile_timer.c
+    TMK_COMMON_DEFS += -DSAMPLE_PROFILE_ENABLE
+endif
+
+ifeq ($(strip $(LOOP_STATS_ENABLE)), yes)
+    TMK_COMMON_SRC += $(COMMON_DIR)/loop_stats.c
+    TMK_COMMON_DEFS += -DLOOP_STATS_ENABLE
+endif
+
 # Bootloader address
 ifdef STM32_BOOTLOADER_ADDRESS
     TMK_COMMON_DEFS += -DSTM32_BOOTLOADER_ADDRESS=$(STM32_BOOTLOADER_ADDRESS)
@@ -26,6 +26,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "action_macro.h"
 #include "action_util.h"
 #include "action.h"
+#include "trace.h"
+#include "latency.h"
 
 #ifdef DEBUG_ACTION
 #include "debug.h"
@@ -42,6 +44,7 @@ void action_exec(keyevent_t event)
     if (!IS_NOEVENT(event)) {
         dprint("\n---- action_exec: start -----\n");
         dprint("EVENT: "); debug_event(event); dprintln();
+        trace("action_exec: %02X%02X %u %u", event.key.row, event.key.col, event.pressed, event.time);
     }
 
 #ifdef FAUXCLICKY_ENABLE
@@ -124,7 +127,10 @@ void process_record(keyrecord_t *record)
 {
     if (IS_NOEVENT(record->event)) { return; }
 
-    if(!process_record_quantum(record))
+    LATENCY_START(quantum_start);
+    bool quantum_continue = process_record_quantum(record);
+    LATENCY_END(LATENCY_PROCESS_RECORD_QUANTUM, quantum_start);
+    if (!quantum_continue)
         return;
 
     action_t action = store_or_get_action(record->event.pressed, record->event.key);
@@ -452,7 +458,7 @@ void process_action(keyrecord_t *record, action_t action)
         /* Extentions */
 #ifndef NO_ACTION_MACRO
         case ACT_MACRO:
-            action_macro_play(action_get_macro(record, action.func.id, action.func.opt));
+            action_macro_play_key(event.key, action_get_macro(record, action.func.id, action.func.opt));
             break;
 #endif
 #ifdef BACKLIGHT_ENABLE
@@ -714,9 +720,11 @@ void clear_keyboard_but_mods(void)
     clear_macro_mods();
     clear_keys();
     send_keyboard_report();
+    host_keyboard_flush();
 #ifdef MOUSEKEY_ENABLE
     mousekey_clear();
     mousekey_send();
+    host_mouse_flush();
 #endif
 #ifdef EXTRAKEY_ENABLE
     host_system_send(0);
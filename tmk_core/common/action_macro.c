@@ -17,7 +17,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "action.h"
 #include "action_util.h"
 #include "action_macro.h"
-#include "wait.h"
+#include "timer.h"
 
 #ifdef DEBUG_ACTION
 #include "debug.h"
@@ -28,14 +28,40 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #ifndef NO_ACTION_MACRO
 
-#define MACRO_READ()  (macro = MACRO_GET(macro_p++))
-void action_macro_play(const macro_t *macro_p)
+/* Macros are played cooperatively. action_macro_play() runs a macro up to
+ * its first WAIT or INTERVAL delay and parks it in a player slot, and
+ * action_macro_task() resumes it from keyboard_task() once the delay has
+ * passed. Macros started by different keys play concurrently, while macros
+ * of the same key are played one after another in the order they were
+ * started, so a release macro never overtakes its press macro.
+ */
+typedef struct {
+    const macro_t *pc;
+    keypos_t key;
+    uint8_t interval;
+    uint16_t resume;
+} macro_player_t;
+
+static macro_player_t players[ACTION_MACRO_PLAYERS];
+static uint8_t players_count = 0;
+
+/* Key used for macros that weren't started by a key event. */
+static const keypos_t no_key = { .row = 0xFF, .col = 0xFF };
+
+static inline bool time_reached(uint16_t time)
+{
+    return (int16_t)(timer_read() - time) >= 0;
+}
+
+/* Runs a macro until it has to wait, returns false when it ended. */
+#define MACRO_READ()  (macro = MACRO_GET(p->pc++))
+static bool macro_player_step(macro_player_t *p, uint16_t now)
 {
     macro_t macro = END;
-    uint8_t interval = 0;
 
-    if (!macro_p) return;
     while (true) {
+        uint8_t delay = 0;
+
         switch (MACRO_READ()) {
             case KEY_DOWN:
                 MACRO_READ();
@@ -60,11 +86,11 @@ void action_macro_play(const macro_t *macro_p)
             case WAIT:
                 MACRO_READ();
                 dprintf("WAIT(%u)\n", macro);
-                { uint8_t ms = macro; while (ms--) wait_ms(1); }
+                delay = macro;
                 break;
             case INTERVAL:
-                interval = MACRO_READ();
-                dprintf("INTERVAL(%u)\n", interval);
+                p->interval = MACRO_READ();
+                dprintf("INTERVAL(%u)\n", p->interval);
                 break;
             case 0x04 ... 0x73:
                 dprintf("DOWN(%02X)\n", macro);
@@ -76,10 +102,89 @@ void action_macro_play(const macro_t *macro_p)
                 break;
             case END:
             default:
-                return;
+                return false;
         }
+
         // interval
-        { uint8_t ms = interval; while (ms--) wait_ms(1); }
+        delay += p->interval;
+        if (delay) {
+            /* Schedule from when the step was due rather than from when it
+             * ran, so a slow loop doesn't stretch the whole macro. */
+            p->resume = now + delay;
+            return true;
+        }
     }
 }
+
+static void macro_player_remove(uint8_t index)
+{
+    players_count--;
+    for (uint8_t i = index; i < players_count; i++) {
+        players[i] = players[i + 1];
+    }
+}
+
+/* Whether a macro started earlier by the same key is still playing. */
+static bool macro_player_blocked(uint8_t index)
+{
+    if (KEYEQ(players[index].key, no_key)) {
+        return false;
+    }
+    for (uint8_t i = 0; i < index; i++) {
+        if (KEYEQ(players[i].key, players[index].key)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void action_macro_task(void)
+{
+    uint8_t i = 0;
+
+    while (i < players_count) {
+        macro_player_t *p = &players[i];
+
+        if (macro_player_blocked(i) || !time_reached(p->resume)) {
+            i++;
+            continue;
+        }
+        /* Keep stepping a macro that has fallen behind until it is back
+         * on schedule. */
+        if (!macro_player_step(p, p->resume)) {
+            macro_player_remove(i);
+        }
+    }
+}
+
+bool action_macro_is_playing(void)
+{
+    return players_count;
+}
+
+void action_macro_play_key(keypos_t key, const macro_t *macro_p)
+{
+    if (!macro_p) return;
+
+    while (players_count == ACTION_MACRO_PLAYERS) {
+        // all players are busy, let them finish to make room
+        action_macro_task();
+    }
+
+    macro_player_t *p = &players[players_count++];
+    p->pc = macro_p;
+    p->key = key;
+    p->interval = 0;
+    p->resume = timer_read();
+
+    // start right away unless it has to wait for an earlier macro of its key
+    if (!macro_player_blocked(players_count - 1) && !macro_player_step(p, p->resume)) {
+        players_count--;
+    }
+}
+
+void action_macro_play(const macro_t *macro_p)
+{
+    action_macro_play_key(no_key, macro_p);
+}
 #endif
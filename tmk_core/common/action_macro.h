@@ -17,7 +17,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef ACTION_MACRO_H
 #define ACTION_MACRO_H
 #include <stdint.h>
+#include <stdbool.h>
 #include "progmem.h"
+#include "keyboard.h"
 
 
 
@@ -49,10 +51,21 @@ typedef uint8_t macro_t;
      
 
 
+/* number of macros that can be playing or waiting to play at once */
+#ifndef ACTION_MACRO_PLAYERS
+#define ACTION_MACRO_PLAYERS 4
+#endif
+
 #ifndef NO_ACTION_MACRO
 void action_macro_play(const macro_t *macro_p);
+void action_macro_play_key(keypos_t key, const macro_t *macro_p);
+void action_macro_task(void);
+bool action_macro_is_playing(void);
 #else
 #define action_macro_play(macro)
+#define action_macro_play_key(key, macro)
+#define action_macro_task()
+#define action_macro_is_playing() false
 #endif
 
 
@@ -20,31 +20,35 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "action_util.h"
 #include "action_layer.h"
 #include "timer.h"
+#include "latency.h"
 #include "keycode_config.h"
 
 extern keymap_config_t keymap_config;
 
 
-static inline void add_key_byte(uint8_t code);
-static inline void del_key_byte(uint8_t code);
-#ifdef NKRO_ENABLE
-static inline void add_key_bit(uint8_t code);
-static inline void del_key_bit(uint8_t code);
-#endif
+static void boot_keys_add(uint8_t code);
+static void boot_keys_del(uint8_t code);
 
 static uint8_t real_mods = 0;
 static uint8_t weak_mods = 0;
 static uint8_t macro_mods = 0;
 
-#ifdef USB_6KRO_ENABLE
-#define RO_ADD(a, b) ((a + b) % KEYBOARD_REPORT_KEYS)
-#define RO_SUB(a, b) ((a - b + KEYBOARD_REPORT_KEYS) % KEYBOARD_REPORT_KEYS)
-#define RO_INC(a) RO_ADD(a, 1)
-#define RO_DEC(a) RO_SUB(a, 1)
-static int8_t cb_head = 0;
-static int8_t cb_tail = 0;
-static int8_t cb_count = 0;
+/* Pressed keys, one bit per key code. This is the only key state, the
+ * reports are generated from it in send_keyboard_report(). */
+static uint8_t key_bits[32];
+static uint8_t key_count = 0;
+
+/* Keys in the boot protocol report, oldest first */
+#if KEYBOARD_REPORT_KEYS > 6
+#   define BOOT_REPORT_KEYS 6
+#else
+#   define BOOT_REPORT_KEYS KEYBOARD_REPORT_KEYS
 #endif
+static uint8_t boot_keys[BOOT_REPORT_KEYS];
+static uint8_t boot_count = 0;
+
+#define KEY_BIT(code) (1 << ((code) & 7))
+#define IS_KEY_PRESSED(code) (key_bits[(code) >> 3] & KEY_BIT(code))
 
 // TODO: pointer variable is not needed
 //report_keyboard_t keyboard_report = {};
@@ -118,6 +122,7 @@ bool is_oneshot_layer_active(void)
 #endif
 
 void send_keyboard_report(void) {
+    LATENCY_START(report_start);
     keyboard_report->mods  = real_mods;
     keyboard_report->mods |= weak_mods;
     keyboard_report->mods |= macro_mods;
@@ -136,38 +141,64 @@ void send_keyboard_report(void) {
     }
 
 #endif
+
+#ifdef NKRO_ENABLE
+    if (keyboard_protocol && keymap_config.nkro) {
+        keyboard_report_nkro(keyboard_report);
+    } else
+#endif
+    keyboard_report_boot(keyboard_report);
     host_keyboard_send(keyboard_report);
+    LATENCY_END(LATENCY_SEND_KEYBOARD_REPORT, report_start);
 }
 
-/* key */
-void add_key(uint8_t key)
+/* Fill the key part of a report, mods are left alone */
+void keyboard_report_boot(report_keyboard_t *report)
 {
+    uint8_t i = 0;
+    for (; i < boot_count; i++) {
+        report->keys[i] = boot_keys[i];
+    }
+    for (; i < KEYBOARD_REPORT_KEYS; i++) {
+        report->keys[i] = 0;
+    }
+    report->reserved = 0;
+}
+
 #ifdef NKRO_ENABLE
-    if (keyboard_protocol && keymap_config.nkro) {
-        add_key_bit(key);
-        return;
+void keyboard_report_nkro(report_keyboard_t *report)
+{
+    for (uint8_t i = 0; i < KEYBOARD_REPORT_BITS; i++) {
+        report->nkro.bits[i] = i < sizeof(key_bits) ? key_bits[i] : 0;
     }
+}
 #endif
-    add_key_byte(key);
+
+/* key */
+void add_key(uint8_t key)
+{
+    if (!key || IS_KEY_PRESSED(key)) return;
+    key_bits[key >> 3] |= KEY_BIT(key);
+    key_count++;
+    boot_keys_add(key);
 }
 
 void del_key(uint8_t key)
 {
-#ifdef NKRO_ENABLE
-    if (keyboard_protocol && keymap_config.nkro) {
-        del_key_bit(key);
-        return;
-    }
-#endif
-    del_key_byte(key);
+    if (!key || !IS_KEY_PRESSED(key)) return;
+    key_bits[key >> 3] &= ~KEY_BIT(key);
+    key_count--;
+    boot_keys_del(key);
 }
 
 void clear_keys(void)
 {
     // not clear mods
-    for (int8_t i = 1; i < KEYBOARD_REPORT_SIZE; i++) {
-        keyboard_report->raw[i] = 0;
+    for (uint8_t i = 0; i < sizeof(key_bits); i++) {
+        key_bits[i] = 0;
     }
+    key_count = 0;
+    boot_count = 0;
 }
 
 
@@ -219,12 +250,7 @@ uint8_t get_oneshot_mods(void)
  */
 uint8_t has_anykey(void)
 {
-    uint8_t cnt = 0;
-    for (uint8_t i = 1; i < KEYBOARD_REPORT_SIZE; i++) {
-        if (keyboard_report->raw[i])
-            cnt++;
-    }
-    return cnt;
+    return key_count;
 }
 
 uint8_t has_anymod(void)
@@ -234,149 +260,55 @@ uint8_t has_anymod(void)
 
 uint8_t get_first_key(void)
 {
-#ifdef NKRO_ENABLE
-    if (keyboard_protocol && keymap_config.nkro) {
-        uint8_t i = 0;
-        for (; i < KEYBOARD_REPORT_BITS && !keyboard_report->nkro.bits[i]; i++)
-            ;
-        return i<<3 | biton(keyboard_report->nkro.bits[i]);
-    }
-#endif
-#ifdef USB_6KRO_ENABLE
-    uint8_t i = cb_head;
-    do {
-        if (keyboard_report->keys[i] != 0) {
-            break;
-        }
-        i = RO_INC(i);
-    } while (i != cb_tail);
-    return keyboard_report->keys[i];
-#else
-    return keyboard_report->keys[0];
-#endif
+    return boot_count ? boot_keys[0] : 0;
 }
 
 
 
 /* local functions */
-static inline void add_key_byte(uint8_t code)
+static void boot_keys_add(uint8_t code)
 {
-#ifdef USB_6KRO_ENABLE
-    int8_t i = cb_head;
-    int8_t empty = -1;
-    if (cb_count) {
-        do {
-            if (keyboard_report->keys[i] == code) {
-                return;
-            }
-            if (empty == -1 && keyboard_report->keys[i] == 0) {
-                empty = i;
-            }
-            i = RO_INC(i);
-        } while (i != cb_tail);
-        if (i == cb_tail) {
-            if (cb_tail == cb_head) {
-                // buffer is full
-                if (empty == -1) {
-                    // pop head when has no empty space
-                    cb_head = RO_INC(cb_head);
-                    cb_count--;
-                }
-                else {
-                    // left shift when has empty space
-                    uint8_t offset = 1;
-                    i = RO_INC(empty);
-                    do {
-                        if (keyboard_report->keys[i] != 0) {
-                            keyboard_report->keys[empty] = keyboard_report->keys[i];
-                            keyboard_report->keys[i] = 0;
-                            empty = RO_INC(empty);
-                        }
-                        else {
-                            offset++;
-                        }
-                        i = RO_INC(i);
-                    } while (i != cb_tail);
-                    cb_tail = RO_SUB(cb_tail, offset);
-                }
-            }
-        }
-    }
-    // add to tail
-    keyboard_report->keys[cb_tail] = code;
-    cb_tail = RO_INC(cb_tail);
-    cb_count++;
-#else
-    int8_t i = 0;
-    int8_t empty = -1;
-    for (; i < KEYBOARD_REPORT_KEYS; i++) {
-        if (keyboard_report->keys[i] == code) {
-            break;
-        }
-        if (empty == -1 && keyboard_report->keys[i] == 0) {
-            empty = i;
-        }
+    if (boot_count < BOOT_REPORT_KEYS) {
+        boot_keys[boot_count++] = code;
+        return;
     }
-    if (i == KEYBOARD_REPORT_KEYS) {
-        if (empty != -1) {
-            keyboard_report->keys[empty] = code;
-        }
+#ifdef USB_6KRO_ENABLE
+    // newest keys win, drop the oldest
+    for (uint8_t i = 1; i < BOOT_REPORT_KEYS; i++) {
+        boot_keys[i - 1] = boot_keys[i];
     }
+    boot_keys[BOOT_REPORT_KEYS - 1] = code;
 #endif
 }
 
-static inline void del_key_byte(uint8_t code)
+static bool boot_keys_has(uint8_t code)
 {
-#ifdef USB_6KRO_ENABLE
-    uint8_t i = cb_head;
-    if (cb_count) {
-        do {
-            if (keyboard_report->keys[i] == code) {
-                keyboard_report->keys[i] = 0;
-                cb_count--;
-                if (cb_count == 0) {
-                    // reset head and tail
-                    cb_tail = cb_head = 0;
-                }
-                if (i == RO_DEC(cb_tail)) {
-                    // left shift when next to tail
-                    do {
-                        cb_tail = RO_DEC(cb_tail);
-                        if (keyboard_report->keys[RO_DEC(cb_tail)] != 0) {
-                            break;
-                        }
-                    } while (cb_tail != cb_head);
-                }
-                break;
-            }
-            i = RO_INC(i);
-        } while (i != cb_tail);
-    }
-#else
-    for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
-        if (keyboard_report->keys[i] == code) {
-            keyboard_report->keys[i] = 0;
-        }
+    for (uint8_t i = 0; i < boot_count; i++) {
+        if (boot_keys[i] == code) return true;
     }
-#endif
+    return false;
 }
 
-#ifdef NKRO_ENABLE
-static inline void add_key_bit(uint8_t code)
+static void boot_keys_del(uint8_t code)
 {
-    if ((code>>3) < KEYBOARD_REPORT_BITS) {
-        keyboard_report->nkro.bits[code>>3] |= 1<<(code&7);
-    } else {
-        dprintf("add_key_bit: can't add: %02X\n", code);
+    uint8_t i = 0;
+    for (; i < boot_count && boot_keys[i] != code; i++)
+        ;
+    if (i == boot_count) return;
+    for (boot_count--; i < boot_count; i++) {
+        boot_keys[i] = boot_keys[i + 1];
     }
-}
 
-static inline void del_key_bit(uint8_t code)
-{
-    if ((code>>3) < KEYBOARD_REPORT_BITS) {
-        keyboard_report->nkro.bits[code>>3] &= ~(1<<(code&7));
-    } else {
-        dprintf("del_key_bit: can't del: %02X\n", code);
+    // a key still held that didn't fit before takes the free slot
+    if (key_count <= boot_count) return;
+    for (uint8_t b = 0; b < sizeof(key_bits); b++) {
+        if (!key_bits[b]) continue;
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            uint8_t k = b << 3 | bit;
+            if ((key_bits[b] & (1 << bit)) && !boot_keys_has(k)) {
+                boot_keys[boot_count++] = k;
+                return;
+            }
+        }
     }
 }
-#endif
@@ -28,6 +28,12 @@ extern report_keyboard_t *keyboard_report;
 
 void send_keyboard_report(void);
 
+/* report generators, fill the key part of report from the pressed keys */
+void keyboard_report_boot(report_keyboard_t *report);
+#ifdef NKRO_ENABLE
+void keyboard_report_nkro(report_keyboard_t *report);
+#endif
+
 /* key */
 void add_key(uint8_t key);
 void del_key(uint8_t key);
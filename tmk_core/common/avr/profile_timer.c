@@ -0,0 +1,112 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "profile.h"
+
+#ifndef PROFILE_TIMER
+#define PROFILE_TIMER 1
+#endif
+
+#ifndef PROFILE_FREQUENCY
+#define PROFILE_FREQUENCY 997   // not a multiple of the 1ms tasks
+#endif
+
+/* profile_init() runs last and would take the timer over without a word */
+#if PROFILE_TIMER == 1 && defined(BACKLIGHT_ENABLE)
+#   error "Timer1 is the backlight PWM, profile with PROFILE_TIMER 3"
+#elif PROFILE_TIMER == 3 && (defined(AUDIO_ENABLE) || defined(FAUXCLICKY_ENABLE))
+#   error "Timer3 is used by audio and fauxclicky, profile with PROFILE_TIMER 1"
+#endif
+
+#if PROFILE_TIMER == 1
+#   define PROFILE_TCCRA    TCCR1A
+#   define PROFILE_TCCRB    TCCR1B
+#   define PROFILE_OCR      OCR1A
+#   define PROFILE_TIMSK    TIMSK1
+#   define PROFILE_OCIE     OCIE1A
+#   define PROFILE_WGM      WGM12
+#   define PROFILE_CS       CS11
+#   define PROFILE_VECTOR   TIMER1_COMPA_vect
+#elif PROFILE_TIMER == 3
+#   define PROFILE_TCCRA    TCCR3A
+#   define PROFILE_TCCRB    TCCR3B
+#   define PROFILE_OCR      OCR3A
+#   define PROFILE_TIMSK    TIMSK3
+#   define PROFILE_OCIE     OCIE3A
+#   define PROFILE_WGM      WGM32
+#   define PROFILE_CS       CS31
+#   define PROFILE_VECTOR   TIMER3_COMPA_vect
+#else
+#   error "PROFILE_TIMER must be 1 or 3"
+#endif
+
+#if (F_CPU / 8 / PROFILE_FREQUENCY) > 65536
+#   error "PROFILE_FREQUENCY too low for a 16 bit timer"
+#endif
+
+void profile_timer_init(void)
+{
+    // CTC mode, clk/8
+    PROFILE_TCCRA = 0;
+    PROFILE_TCCRB = (1 << PROFILE_WGM) | (1 << PROFILE_CS);
+    PROFILE_OCR = F_CPU / 8 / PROFILE_FREQUENCY - 1;
+    PROFILE_TIMSK |= (1 << PROFILE_OCIE);
+}
+
+/* Naked so the stack layout is known: saves what the C calling convention
+ * lets profile_sample() clobber, then reads the return address pushed by the
+ * interrupt, high byte at the lower address, from above those 15 bytes. It
+ * is 2 or 3 bytes long and passed on as a 32 bit argument in r22-r25.
+ */
+ISR(PROFILE_VECTOR, ISR_NAKED)
+{
+    __asm__ volatile (
+        "push r1"               "\n\t"
+        "push r0"               "\n\t"
+        "in r0, __SREG__"       "\n\t"
+        "push r0"               "\n\t"
+        "clr r1"                "\n\t"
+        "push r18"              "\n\t"
+        "push r19"              "\n\t"
+        "push r20"              "\n\t"
+        "push r21"              "\n\t"
+        "push r22"              "\n\t"
+        "push r23"              "\n\t"
+        "push r24"              "\n\t"
+        "push r25"              "\n\t"
+        "push r26"              "\n\t"
+        "push r27"              "\n\t"
+        "push r30"              "\n\t"
+        "push r31"              "\n\t"
+        "in r30, __SP_L__"      "\n\t"
+        "in r31, __SP_H__"      "\n\t"
+#ifdef __AVR_3_BYTE_PC__
+        "ldd r24, Z+16"         "\n\t"
+        "ldd r23, Z+17"         "\n\t"
+        "ldd r22, Z+18"         "\n\t"
+#else
+        "mov r24, r1"           "\n\t"
+        "ldd r23, Z+16"         "\n\t"
+        "ldd r22, Z+17"         "\n\t"
+#endif
+        "mov r25, r1"           "\n\t"
+        "%~call profile_sample" "\n\t"
+        "pop r31"               "\n\t"
+        "pop r30"               "\n\t"
+        "pop r27"               "\n\t"
+        "pop r26"               "\n\t"
+        "pop r25"               "\n\t"
+        "pop r24"               "\n\t"
+        "pop r23"               "\n\t"
+        "pop r22"               "\n\t"
+        "pop r21"               "\n\t"
+        "pop r20"               "\n\t"
+        "pop r19"               "\n\t"
+        "pop r18"               "\n\t"
+        "pop r0"                "\n\t"
+        "out __SREG__, r0"      "\n\t"
+        "pop r0"                "\n\t"
+        "pop r1"                "\n\t"
+        "reti"                  "\n\t"
+        ::
+    );
+}
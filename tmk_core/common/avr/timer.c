@@ -116,6 +116,31 @@ uint32_t timer_elapsed32(uint32_t last)
     return TIMER_DIFF_32(t, last);
 }
 
+/* Timer0 ticks, TIMER_RAW_TOP + 1 per ms */
+uint16_t timer_read_ticks(void)
+{
+    uint16_t ms;
+    uint8_t raw;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      ms = timer_count;
+      raw = TIMER_RAW;
+      // counter wrapped but the interrupt hasn't counted the ms yet
+#ifndef __AVR_ATmega32A__
+      if ((TIFR0 & (1 << OCF0A)) && raw < TIMER_RAW_TOP / 2) ms++;
+#else
+      if ((TIFR & (1 << OCF0)) && raw < TIMER_RAW_TOP / 2) ms++;
+#endif
+    }
+
+    return ms * (TIMER_RAW_TOP + 1) + raw;
+}
+
+uint32_t timer_ticks_to_us(uint32_t ticks)
+{
+    return ticks * TIMER_PRESCALER / (F_CPU / 1000000);
+}
+
 // excecuted once per 1ms.(excess for just timer count?)
 #ifndef __AVR_ATmega32A__
 #define TIMER_INTERRUPT_VECTOR TIMER0_COMPA_vect
@@ -0,0 +1,31 @@
+#include "ch.h"
+#include "profile.h"
+
+#ifndef PROFILE_INTERVAL_US
+#define PROFILE_INTERVAL_US 1000
+#endif
+
+static virtual_timer_t profile_vt;
+
+/* vectors.c, the firmware image starts with it */
+extern const uint32_t _vectors;
+
+static void profile_tick(void *arg)
+{
+    (void)arg;
+
+    /* threads run on the process stack, the exception frame the tick
+     * interrupt pushed there has the pc in its seventh word */
+    uint32_t *frame = (uint32_t *)__get_PSP();
+    profile_sample(frame[6]);
+
+    chSysLockFromISR();
+    chVTSetI(&profile_vt, US2ST(PROFILE_INTERVAL_US), profile_tick, NULL);
+    chSysUnlockFromISR();
+}
+
+void profile_timer_init(void)
+{
+    profile_base = (uint32_t)&_vectors;
+    chVTSet(&profile_vt, US2ST(PROFILE_INTERVAL_US), profile_tick, NULL);
+}
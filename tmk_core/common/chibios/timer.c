@@ -25,3 +25,14 @@ uint32_t timer_elapsed32(uint32_t last)
 {
     return ST2MS(chVTTimeElapsedSinceX(MS2ST(last)));
 }
+
+uint16_t timer_read_ticks(void)
+{
+    return (uint16_t)chVTGetSystemTimeX();
+}
+
+uint32_t timer_ticks_to_us(uint32_t ticks)
+{
+    // ST2US() overflows on sums of ticks
+    return (uint64_t)ticks * 1000000 / CH_CFG_ST_FREQUENCY;
+}
@@ -32,6 +32,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "sleep_led.h"
 #include "led.h"
 #include "command.h"
+#include "latency.h"
+#include "profile.h"
+#include "loop_stats.h"
 #include "backlight.h"
 #include "quantum.h"
 #include "version.h"
@@ -49,6 +52,20 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #ifdef PROTOCOL_VUSB
 	#include "usbdrv.h"
+	#include "vusb.h"
+#endif
+
+#ifdef PROTOCOL_CHIBIOS
+	#include "usb_main.h"
+#endif
+
+#ifdef PROTOCOL_LUFA
+	extern uint16_t keyboard_queue_waits;
+	extern uint16_t keyboard_queue_drops;
+#ifdef CONSOLE_ENABLE
+	extern uint16_t console_drops;
+#endif
+	void usb_latency_test(void);
 #endif
 
 #ifdef AUDIO_ENABLE
@@ -170,6 +187,22 @@ static void command_common_help(void)
 #ifdef SLEEP_LED_ENABLE
 		STR(MAGIC_KEY_SLEEP_LED   ) ":	Sleep LED Test\n"
 #endif
+
+#if defined(PROTOCOL_LUFA) || defined(PROTOCOL_CHIBIOS)
+		STR(MAGIC_KEY_USB_LATENCY ) ":	USB Latency Test\n"
+#endif
+
+#ifdef LATENCY_PROFILE_ENABLE
+		STR(MAGIC_KEY_LATENCY_PROFILE) ":	Latency Profile (print and reset)\n"
+#endif
+
+#ifdef SAMPLE_PROFILE_ENABLE
+		STR(MAGIC_KEY_SAMPLE_PROFILE) ":	Sampling Profile (print and reset)\n"
+#endif
+
+#ifdef LOOP_STATS_ENABLE
+		STR(MAGIC_KEY_LOOP_STATS  ) ":	Scan Rate and Loop Load\n"
+#endif
     );
 }
 
@@ -257,6 +290,23 @@ static void print_status(void)
 #   if USB_COUNT_SOF
     print_val_hex8(usbSofCount);
 #   endif
+#endif
+
+#ifdef PROTOCOL_LUFA
+    print_val_dec(keyboard_queue_waits);
+    print_val_dec(keyboard_queue_drops);
+#ifdef CONSOLE_ENABLE
+    print_val_dec(console_drops);
+#endif
+#endif
+
+#ifdef PROTOCOL_VUSB
+    print_val_dec(vusb_kbuf_depth_max);
+    print_val_dec(vusb_kbuf_drops);
+#endif
+
+#ifdef PROTOCOL_CHIBIOS
+    usb_report_queue_stats();
 #endif
 	return;
 }
@@ -433,6 +483,35 @@ static bool command_common(uint8_t code)
 			print_status();
             break;
 
+#if defined(PROTOCOL_LUFA) || defined(PROTOCOL_CHIBIOS)
+
+		// measure how long reports wait for the host
+		case MAGIC_KC(MAGIC_KEY_USB_LATENCY):
+			print("USB Latency Test\n");
+			usb_latency_test();
+			break;
+#endif
+
+#ifdef LATENCY_PROFILE_ENABLE
+		case MAGIC_KC(MAGIC_KEY_LATENCY_PROFILE):
+			latency_print();
+			latency_clear();
+			break;
+#endif
+
+#ifdef SAMPLE_PROFILE_ENABLE
+		case MAGIC_KC(MAGIC_KEY_SAMPLE_PROFILE):
+			profile_print();
+			profile_clear();
+			break;
+#endif
+
+#ifdef LOOP_STATS_ENABLE
+		case MAGIC_KC(MAGIC_KEY_LOOP_STATS):
+			loop_stats_print();
+			break;
+#endif
+
 #ifdef NKRO_ENABLE
 
 		// NKRO toggle
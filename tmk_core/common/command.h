@@ -151,6 +151,22 @@ bool command_proc(uint8_t code);
 
 #endif
 
+#ifndef MAGIC_KEY_USB_LATENCY
+#define MAGIC_KEY_USB_LATENCY    U
+#endif
+
+#ifndef MAGIC_KEY_LATENCY_PROFILE
+#define MAGIC_KEY_LATENCY_PROFILE P
+#endif
+
+#ifndef MAGIC_KEY_SAMPLE_PROFILE
+#define MAGIC_KEY_SAMPLE_PROFILE F
+#endif
+
+#ifndef MAGIC_KEY_LOOP_STATS
+#define MAGIC_KEY_LOOP_STATS     L
+#endif
+
 #define XMAGIC_KC(key) KC_##key
 #define MAGIC_KC(key) XMAGIC_KC(key)
 
@@ -33,6 +33,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define EECONFIG_BACKLIGHT                          (uint8_t *)6
 #define EECONFIG_AUDIO                              (uint8_t *)7
 #define EECONFIG_RGBLIGHT                           (uint32_t *)8
+/* start of the region used by persistent dynamic macros */
+#define EECONFIG_DYNAMIC_MACRO                      (uint8_t *)12
 
 
 /* debug bit */
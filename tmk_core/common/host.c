@@ -16,19 +16,58 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <stdint.h>
+#include <string.h>
 //#include <avr/interrupt.h>
 #include "keycode.h"
 #include "host.h"
 #include "util.h"
+#include "timer.h"
+#include "latency.h"
 #include "debug.h"
 
+#ifdef NKRO_ENABLE
+  #include "keycode_config.h"
+
+  extern keymap_config_t keymap_config;
+#endif
+
 static host_driver_t *driver;
 static uint16_t last_system_report = 0;
 static uint16_t last_consumer_report = 0;
 
+/* While keyboard_task() runs the actions of a scan, between the two
+ * host_keyboard_hold() calls, keyboard reports are staged and merged and
+ * go out once at the end, see host_keyboard_flush(). Anywhere else, and
+ * before a wait or any other report, they are sent right away.
+ * last_keyboard_report is what the host has seen. */
+static report_keyboard_t last_keyboard_report;
+static report_keyboard_t staged_keyboard_report;
+static bool keyboard_report_dirty = false;
+static bool keyboard_report_held = false;
+
+/* Mouse motion from every source adds up here in 1/HOST_MOUSE_SUBUNITS
+ * counts and goes out as one report per keyboard_task(), at most every
+ * MOUSE_REPORT_INTERVAL ms. What doesn't fit a report carries over.
+ * Set it in config.h, usually to MOUSE_POLLING_INTERVAL. The USB
+ * descriptors aren't visible here on every protocol, so it doesn't
+ * follow them. */
+#ifndef MOUSE_REPORT_INTERVAL
+#   define MOUSE_REPORT_INTERVAL 0
+#endif
+static int16_t mouse_x = 0;
+static int16_t mouse_y = 0;
+static int16_t mouse_v = 0;
+static int16_t mouse_h = 0;
+static uint8_t mouse_buttons = 0;
+static uint8_t mouse_sent_buttons = 0;
+static bool mouse_dirty = false;
+static uint16_t mouse_last_send = 0;
+
 
 void host_set_driver(host_driver_t *d)
 {
+    host_keyboard_flush();
+    host_mouse_flush();
     driver = d;
 }
 
@@ -42,11 +81,13 @@ uint8_t host_keyboard_leds(void)
     if (!driver) return 0;
     return (*driver->keyboard_leds)();
 }
-/* send report */
-void host_keyboard_send(report_keyboard_t *report)
+static void keyboard_report_out(report_keyboard_t *report)
 {
-    if (!driver) return;
+    LATENCY_START(driver_start);
     (*driver->send_keyboard)(report);
+    LATENCY_END(LATENCY_SEND_KEYBOARD, driver_start);
+    latency_sent();
+    last_keyboard_report = *report;
 
     if (debug_keyboard) {
         dprint("keyboard_report: ");
@@ -57,10 +98,158 @@ void host_keyboard_send(report_keyboard_t *report)
     }
 }
 
-void host_mouse_send(report_mouse_t *report)
+static bool report_has_key(const report_keyboard_t *report, uint8_t key)
+{
+    for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+        if (report->keys[i] == key) return true;
+    }
+    return false;
+}
+
+/* true if key went in or out between sent and pending and next undoes that */
+static bool key_edge_lost(const report_keyboard_t *sent, const report_keyboard_t *pending,
+                          const report_keyboard_t *next, uint8_t key)
+{
+    bool in_pending = report_has_key(pending, key);
+    return report_has_key(sent, key) != in_pending &&
+           report_has_key(next, key) != in_pending;
+}
+
+/* Replacing pending with next must not hide a press or release the host
+ * hasn't seen yet, so no bit may change in both steps. */
+bool host_keyboard_mergeable(const report_keyboard_t *sent, const report_keyboard_t *pending,
+                             const report_keyboard_t *next)
+{
+    uint8_t pending_mods = sent->mods ^ pending->mods;
+    if (pending_mods & (pending->mods ^ next->mods)) return false;
+
+#ifdef NKRO_ENABLE
+    if (keyboard_protocol && keymap_config.nkro) {
+        for (uint8_t i = 0; i < KEYBOARD_REPORT_BITS; i++) {
+            uint8_t pending_bits = sent->nkro.bits[i] ^ pending->nkro.bits[i];
+            if (pending_bits & (pending->nkro.bits[i] ^ next->nkro.bits[i])) return false;
+        }
+        return true;
+    }
+#endif
+    /* 6KRO keys can move between slots, compare by key code */
+    for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+        if (sent->keys[i] && key_edge_lost(sent, pending, next, sent->keys[i])) return false;
+        if (pending->keys[i] && key_edge_lost(sent, pending, next, pending->keys[i])) return false;
+        if (next->keys[i] && key_edge_lost(sent, pending, next, next->keys[i])) return false;
+    }
+    return true;
+}
+
+/* send report */
+void host_keyboard_send(report_keyboard_t *report)
+{
+    if (!driver) return;
+
+    report_keyboard_t *pending = keyboard_report_dirty ? &staged_keyboard_report : &last_keyboard_report;
+    if (!memcmp(report, pending, sizeof(report_keyboard_t))) return;
+
+#ifdef NO_KEYBOARD_REPORT_COALESCE
+    keyboard_report_out(report);
+#else
+    if (!keyboard_report_held) {
+        host_keyboard_flush();
+        keyboard_report_out(report);
+        return;
+    }
+    if (keyboard_report_dirty &&
+        !host_keyboard_mergeable(&last_keyboard_report, &staged_keyboard_report, report)) {
+        keyboard_report_out(&staged_keyboard_report);
+    }
+    staged_keyboard_report = *report;
+    keyboard_report_dirty = true;
+#endif
+}
+
+void host_keyboard_hold(bool hold)
+{
+    if (!hold) host_keyboard_flush();
+    keyboard_report_held = hold;
+}
+
+void host_keyboard_flush(void)
+{
+    if (!keyboard_report_dirty) return;
+    keyboard_report_dirty = false;
+
+    if (!driver) return;
+    if (!memcmp(&staged_keyboard_report, &last_keyboard_report, sizeof(report_keyboard_t))) return;
+    keyboard_report_out(&staged_keyboard_report);
+}
+
+static void mouse_add(int16_t *acc, int16_t delta)
+{
+    int32_t sum = (int32_t)*acc + delta;
+    *acc = sum > INT16_MAX ? INT16_MAX : (sum < -INT16_MAX ? -INT16_MAX : sum);
+}
+
+/* whole counts that fit a report, the rest stays in acc */
+static int8_t mouse_take(int16_t *acc)
+{
+    int16_t counts = *acc / HOST_MOUSE_SUBUNITS;
+    if (counts > 127) counts = 127;
+    if (counts < -127) counts = -127;
+    *acc -= counts * HOST_MOUSE_SUBUNITS;
+    return counts;
+}
+
+static void mouse_out(void)
 {
+    report_mouse_t report = {
+        .buttons = mouse_buttons,
+        .x = mouse_take(&mouse_x),
+        .y = mouse_take(&mouse_y),
+        .v = mouse_take(&mouse_v),
+        .h = mouse_take(&mouse_h)
+    };
+    mouse_dirty = mouse_x / HOST_MOUSE_SUBUNITS || mouse_y / HOST_MOUSE_SUBUNITS ||
+                  mouse_v / HOST_MOUSE_SUBUNITS || mouse_h / HOST_MOUSE_SUBUNITS;
+
     if (!driver) return;
-    (*driver->send_mouse)(report);
+    if (!report.x && !report.y && !report.v && !report.h && report.buttons == mouse_sent_buttons) return;
+    host_keyboard_flush();
+    (*driver->send_mouse)(&report);
+    mouse_sent_buttons = report.buttons;
+    mouse_last_send = timer_read();
+}
+
+void host_mouse_send(report_mouse_t *report)
+{
+    host_mouse_buttons(report->buttons);
+    host_mouse_move(report->x * HOST_MOUSE_SUBUNITS, report->y * HOST_MOUSE_SUBUNITS,
+                    report->v * HOST_MOUSE_SUBUNITS, report->h * HOST_MOUSE_SUBUNITS);
+}
+
+void host_mouse_buttons(uint8_t buttons)
+{
+    if (buttons == mouse_buttons) return;
+    /* every button change goes out right away in its own report, after the
+     * motion before it, only motion is merged */
+    if (mouse_dirty) mouse_out();
+    mouse_buttons = buttons;
+    mouse_out();
+}
+
+void host_mouse_move(int16_t x, int16_t y, int16_t v, int16_t h)
+{
+    mouse_add(&mouse_x, x);
+    mouse_add(&mouse_y, y);
+    mouse_add(&mouse_v, v);
+    mouse_add(&mouse_h, h);
+    if (x || y || v || h) mouse_dirty = true;
+}
+
+void host_mouse_flush(void)
+{
+    if (!mouse_dirty) return;
+    if (mouse_buttons == mouse_sent_buttons &&
+        timer_elapsed(mouse_last_send) < MOUSE_REPORT_INTERVAL) return;
+    mouse_out();
 }
 
 void host_system_send(uint16_t report)
@@ -69,6 +258,7 @@ void host_system_send(uint16_t report)
     last_system_report = report;
 
     if (!driver) return;
+    host_keyboard_flush();
     (*driver->send_system)(report);
 }
 
@@ -78,6 +268,7 @@ void host_consumer_send(uint16_t report)
     last_consumer_report = report;
 
     if (!driver) return;
+    host_keyboard_flush();
     (*driver->send_consumer)(report);
 }
 
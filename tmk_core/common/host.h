@@ -39,7 +39,17 @@ host_driver_t *host_get_driver(void);
 /* host driver interface */
 uint8_t host_keyboard_leds(void);
 void host_keyboard_send(report_keyboard_t *report);
+/* true holds keyboard reports back to merge them, false sends what is held */
+void host_keyboard_hold(bool hold);
+void host_keyboard_flush(void);
+bool host_keyboard_mergeable(const report_keyboard_t *sent, const report_keyboard_t *pending,
+                             const report_keyboard_t *next);
 void host_mouse_send(report_mouse_t *report);
+/* motion in 1/HOST_MOUSE_SUBUNITS counts, for sources with sub-count precision */
+#define HOST_MOUSE_SUBUNITS 16
+void host_mouse_buttons(uint8_t buttons);
+void host_mouse_move(int16_t x, int16_t y, int16_t v, int16_t h);
+void host_mouse_flush(void);
 void host_system_send(uint16_t data);
 void host_consumer_send(uint16_t data);
 
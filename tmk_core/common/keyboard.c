@@ -25,12 +25,17 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "timer.h"
 #include "print.h"
 #include "debug.h"
+#include "trace.h"
+#include "latency.h"
+#include "profile.h"
+#include "loop_stats.h"
 #include "command.h"
 #include "util.h"
 #include "sendchar.h"
 #include "eeconfig.h"
 #include "backlight.h"
 #include "action_layer.h"
+#include "action_macro.h"
 #ifdef BOOTMAGIC_ENABLE
 #   include "bootmagic.h"
 #else
@@ -117,6 +122,7 @@ void keyboard_init(void) {
 #if defined(NKRO_ENABLE) && defined(FORCE_NKRO)
     keymap_config.nkro = 1;
 #endif
+    profile_init();
 }
 
 /*
@@ -133,7 +139,12 @@ void keyboard_task(void)
     matrix_row_t matrix_row = 0;
     matrix_row_t matrix_change = 0;
 
+    loop_stats_loop();
+    latency_scan_start();
     matrix_scan();
+    loop_stats_scan();
+    // merge the keyboard reports of this scan's actions into one
+    host_keyboard_hold(true);
     for (uint8_t r = 0; r < MATRIX_ROWS; r++) {
         matrix_row = matrix_get_row(r);
         matrix_change = matrix_row ^ matrix_prev[r];
@@ -155,11 +166,14 @@ void keyboard_task(void)
             if (debug_matrix) matrix_print();
             for (uint8_t c = 0; c < MATRIX_COLS; c++) {
                 if (matrix_change & ((matrix_row_t)1<<c)) {
+                    latency_scan_event();
+                    LATENCY_START(action_start);
                     action_exec((keyevent_t){
                         .key = (keypos_t){ .row = r, .col = c },
                         .pressed = (matrix_row & ((matrix_row_t)1<<c)),
                         .time = (timer_read() | 1) /* time should not be 0 */
                     });
+                    LATENCY_END(LATENCY_ACTION_EXEC, action_start);
                     // record a processed key
                     matrix_prev[r] ^= ((matrix_row_t)1<<c);
                     // process a key per task call
@@ -172,10 +186,18 @@ void keyboard_task(void)
     action_exec(TICK);
 
 MATRIX_LOOP_END:
+    host_keyboard_hold(false);
+
+#ifndef NO_ACTION_MACRO
+    // resume macros waiting on WAIT/INTERVAL
+    action_macro_task();
+#endif
 
 #ifdef MOUSEKEY_ENABLE
     // mousekey repeat & acceleration
+    LOOP_STATS_START(mousekey_start);
     mousekey_task();
+    LOOP_STATS_END(LOOP_STATS_MOUSEKEY, mousekey_start);
 #endif
 
 #ifdef PS2_MOUSE_ENABLE
@@ -191,11 +213,20 @@ MATRIX_LOOP_END:
 #endif
 
 #ifdef SERIAL_LINK_ENABLE
+    LOOP_STATS_START(serial_link_start);
 	serial_link_update();
+    LOOP_STATS_END(LOOP_STATS_SERIAL_LINK, serial_link_start);
 #endif
 
+    // send the mouse motion added up during this scan
+    host_mouse_flush();
+
+    trace_task();
+
 #ifdef VISUALIZER_ENABLE
+    LOOP_STATS_START(visualizer_start);
     visualizer_update(default_layer_state, layer_state, visualizer_get_mods(), host_keyboard_leds());
+    LOOP_STATS_END(LOOP_STATS_VISUALIZER, visualizer_start);
 #endif
 
     // update LED
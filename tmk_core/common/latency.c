@@ -0,0 +1,110 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "timer.h"
+#include "print.h"
+#include "latency.h"
+
+/* bucket i counts times from 4^i ticks up to 4^(i+1), the last one also above */
+#define LATENCY_BUCKETS 8
+
+typedef struct {
+    uint16_t count;
+    uint16_t min;
+    uint16_t max;
+    uint32_t sum;
+    uint16_t histogram[LATENCY_BUCKETS];
+} latency_stats_t;
+
+static latency_stats_t latency_stats[LATENCY_STAGES];
+static uint16_t scan_start;
+static bool scan_event = false;
+
+uint16_t latency_now(void)
+{
+    return timer_read_ticks();
+}
+
+void latency_record(uint8_t stage, uint16_t start)
+{
+    if (!scan_event || stage >= LATENCY_STAGES) return;
+
+    uint16_t ticks = latency_now() - start;
+    latency_stats_t *stats = &latency_stats[stage];
+    if (!stats->count || ticks < stats->min) stats->min = ticks;
+    if (ticks > stats->max) stats->max = ticks;
+    stats->sum += ticks;
+    if (stats->count < UINT16_MAX) stats->count++;
+
+    uint8_t bucket = 0;
+    for (uint16_t t = ticks >> 2; t && bucket < LATENCY_BUCKETS - 1; t >>= 2) bucket++;
+    if (stats->histogram[bucket] < UINT16_MAX) stats->histogram[bucket]++;
+}
+
+void latency_scan_start(void)
+{
+    scan_start = latency_now();
+    scan_event = false;
+}
+
+/* the scan found a changed key */
+void latency_scan_event(void)
+{
+    if (scan_event) return;
+    scan_event = true;
+    latency_record(LATENCY_MATRIX_SCAN, scan_start);
+}
+
+/* the driver took a report, the first one after an event ends its pipeline */
+void latency_sent(void)
+{
+    latency_record(LATENCY_SCAN_TO_SEND, scan_start);
+    scan_event = false;
+}
+
+static void print_stage(uint8_t stage)
+{
+    switch (stage) {
+        case LATENCY_MATRIX_SCAN:               print("matrix_scan    "); break;
+        case LATENCY_ACTION_EXEC:               print("action_exec    "); break;
+        case LATENCY_PROCESS_RECORD_QUANTUM:    print("process_record "); break;
+        case LATENCY_SEND_KEYBOARD_REPORT:      print("send_report    "); break;
+        case LATENCY_SEND_KEYBOARD:             print("send_keyboard  "); break;
+        case LATENCY_SCAN_TO_SEND:              print("scan_to_send   "); break;
+    }
+}
+
+void latency_print(void)
+{
+    print("\n\t- Latency (us) -\n");
+    print("stage          count min avg max\n");
+    for (uint8_t i = 0; i < LATENCY_STAGES; i++) {
+        latency_stats_t *stats = &latency_stats[i];
+        print_stage(i);
+        xprintf("%u", stats->count);
+        if (stats->count) {
+            xprintf(" %lu %lu %lu", timer_ticks_to_us(stats->min),
+                    timer_ticks_to_us(stats->sum / stats->count), timer_ticks_to_us(stats->max));
+        }
+        print("\n");
+    }
+
+    print("histogram, lower bound of bucket:");
+    for (uint8_t b = 0; b < LATENCY_BUCKETS; b++) {
+        xprintf(" %lu", b ? timer_ticks_to_us(1UL << (2 * b)) : 0UL);
+    }
+    print("\n");
+    for (uint8_t i = 0; i < LATENCY_STAGES; i++) {
+        print_stage(i);
+        for (uint8_t b = 0; b < LATENCY_BUCKETS; b++) {
+            xprintf("%u ", latency_stats[i].histogram[b]);
+        }
+        print("\n");
+    }
+}
+
+void latency_clear(void)
+{
+    for (uint8_t i = 0; i < LATENCY_STAGES; i++) {
+        latency_stats[i] = (latency_stats_t){ 0 };
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+
+/*
+ * Key latency profile
+ *
+ * Times the stages a key event goes through, from the matrix scan that sees
+ * it to the host driver taking the report, and keeps min/avg/max and a
+ * histogram per stage. Stages are timed only when the scan had an event.
+ * Dump with the latency profile command key.
+ *
+ * With LATENCY_PROFILE_ENABLE undefined all of this compiles to nothing.
+ */
+
+enum latency_stage {
+    LATENCY_MATRIX_SCAN,        // scan start to the first changed key
+    LATENCY_ACTION_EXEC,
+    LATENCY_PROCESS_RECORD_QUANTUM,
+    LATENCY_SEND_KEYBOARD_REPORT,
+    LATENCY_SEND_KEYBOARD,      // driver
+    LATENCY_SCAN_TO_SEND,       // scan start to the driver returning
+    LATENCY_STAGES
+};
+
+#ifdef LATENCY_PROFILE_ENABLE
+
+#define LATENCY_START(name)         uint16_t name = latency_now()
+#define LATENCY_END(stage, name)    latency_record(stage, name)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint16_t latency_now(void);
+void latency_record(uint8_t stage, uint16_t start);
+void latency_scan_start(void);
+void latency_scan_event(void);
+void latency_sent(void);
+void latency_print(void);
+void latency_clear(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#else
+
+#define LATENCY_START(name)
+#define LATENCY_END(stage, name)
+#define latency_scan_start()
+#define latency_scan_event()
+#define latency_sent()
+#define latency_print()
+#define latency_clear()
+
+#endif
+
+#endif
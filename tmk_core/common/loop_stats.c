@@ -0,0 +1,112 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "timer.h"
+#include "print.h"
+#include "loop_stats.h"
+#ifdef RAW_ENABLE
+#   include "raw_hid.h"
+#endif
+
+#define LOOP_STATS_WINDOW_MS 1000
+/* 16 bit ticks wrap after about 260 ms on AVR, longer loops are counted in ms */
+#define LOOP_STATS_TICKS_MAX_MS 200
+
+loop_stats_t loop_stats;
+
+static uint16_t window_start;
+static uint16_t scans;
+static uint16_t loops;
+static uint16_t loop_start;
+static uint16_t loop_start_ms;
+static uint16_t loop_max;
+static uint16_t loop_max_ms;
+static uint32_t task_ticks[LOOP_STATS_TASKS];
+
+static void publish(void)
+{
+    loop_stats.scans = scans;
+    loop_stats.loops = loops;
+    loop_stats.loop_max_us = timer_ticks_to_us(loop_max);
+    if ((uint32_t)loop_max_ms * 1000 > loop_stats.loop_max_us) {
+        loop_stats.loop_max_us = (uint32_t)loop_max_ms * 1000;
+    }
+    for (uint8_t i = 0; i < LOOP_STATS_TASKS; i++) {
+        loop_stats.task_us[i] = timer_ticks_to_us(task_ticks[i]);
+        task_ticks[i] = 0;
+    }
+    scans = 0;
+    loops = 0;
+    loop_max = 0;
+    loop_max_ms = 0;
+}
+
+/* called at the start of every keyboard_task() */
+void loop_stats_loop(void)
+{
+    uint16_t now = timer_read_ticks();
+    uint16_t now_ms = timer_read();
+    if (loops) {
+        uint16_t ms = now_ms - loop_start_ms;
+        uint16_t ticks = now - loop_start;
+        if (ms >= LOOP_STATS_TICKS_MAX_MS) {
+            if (ms > loop_max_ms) loop_max_ms = ms;
+        } else if (ticks > loop_max) {
+            loop_max = ticks;
+        }
+    }
+    loop_start = now;
+    loop_start_ms = now_ms;
+
+    if (timer_elapsed(window_start) >= LOOP_STATS_WINDOW_MS) {
+        window_start = timer_read();
+        publish();
+    }
+    if (loops < UINT16_MAX) loops++;
+}
+
+void loop_stats_scan(void)
+{
+    if (scans < UINT16_MAX) scans++;
+}
+
+void loop_stats_task(uint8_t task, uint16_t start)
+{
+    if (task >= LOOP_STATS_TASKS) return;
+    task_ticks[task] += (uint16_t)(timer_read_ticks() - start);
+}
+
+static void print_task(uint8_t task)
+{
+    switch (task) {
+        case LOOP_STATS_RGBLIGHT:       print("rgblight_task:      "); break;
+        case LOOP_STATS_BACKLIGHT:      print("backlight_task:     "); break;
+        case LOOP_STATS_MOUSEKEY:       print("mousekey_task:      "); break;
+        case LOOP_STATS_VISUALIZER:     print("visualizer_update:  "); break;
+        case LOOP_STATS_SERIAL_LINK:    print("serial_link_update: "); break;
+    }
+}
+
+void loop_stats_print(void)
+{
+    print("\n\t- Loop (last second) -\n");
+    xprintf("scans:              %u\n", loop_stats.scans);
+    xprintf("loops:              %u\n", loop_stats.loops);
+    xprintf("longest loop:       %lu us\n", loop_stats.loop_max_us);
+    for (uint8_t i = 0; i < LOOP_STATS_TASKS; i++) {
+        print_task(i);
+        xprintf("%lu us\n", loop_stats.task_us[i]);
+    }
+}
+
+#ifdef RAW_ENABLE
+bool loop_stats_raw_hid(uint8_t *data, uint8_t length)
+{
+    if (length < 1 + sizeof(loop_stats_t) || data[0] != LOOP_STATS_RAW_HID_ID) return false;
+
+    memcpy(data + 1, &loop_stats, sizeof(loop_stats_t));
+    memset(data + 1 + sizeof(loop_stats_t), 0, length - 1 - sizeof(loop_stats_t));
+    raw_hid_send(data, length);
+    return true;
+}
+#endif
@@ -0,0 +1,77 @@
+#ifndef LOOP_STATS_H
+#define LOOP_STATS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Scan rate and main loop load
+ *
+ * Counted over one second windows, the last complete window is kept in
+ * loop_stats: matrix scans, keyboard_task() calls, the longest time from
+ * one keyboard_task() call to the next, which includes whatever the main
+ * loop does besides, and the time spent in each of the tasks below.
+ *
+ * The loop stats command key prints them. With RAW_ENABLE the host can
+ * query them with a raw HID report whose first byte is LOOP_STATS_RAW_HID_ID,
+ * the reply is that byte followed by loop_stats_t, little endian.
+ */
+
+#ifndef LOOP_STATS_RAW_HID_ID
+#define LOOP_STATS_RAW_HID_ID 0xF5
+#endif
+
+enum loop_stats_task {
+    LOOP_STATS_RGBLIGHT,
+    LOOP_STATS_BACKLIGHT,
+    LOOP_STATS_MOUSEKEY,
+    LOOP_STATS_VISUALIZER,
+    LOOP_STATS_SERIAL_LINK,
+    LOOP_STATS_TASKS
+};
+
+typedef struct {
+    uint16_t scans;
+    uint16_t loops;
+    uint32_t loop_max_us;
+    uint32_t task_us[LOOP_STATS_TASKS];
+} __attribute__ ((packed)) loop_stats_t;
+
+#ifdef LOOP_STATS_ENABLE
+
+#include "timer.h"
+
+#define LOOP_STATS_START(name)          uint16_t name = timer_read_ticks()
+#define LOOP_STATS_END(task, name)      loop_stats_task(task, name)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern loop_stats_t loop_stats;
+
+/* keyboard_task() calls these, matrix code that scans on its own can call
+ * loop_stats_scan() itself */
+void loop_stats_loop(void);
+void loop_stats_scan(void);
+void loop_stats_task(uint8_t task, uint16_t start);
+void loop_stats_print(void);
+/* answers a query in a raw HID report, true if it was one */
+bool loop_stats_raw_hid(uint8_t *data, uint8_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#else
+
+#define LOOP_STATS_START(name)
+#define LOOP_STATS_END(task, name)
+#define loop_stats_loop()
+#define loop_stats_scan()
+#define loop_stats_print()
+#define loop_stats_raw_hid(data, length) false
+
+#endif
+
+#endif
@@ -39,3 +39,14 @@ uint32_t timer_elapsed32(uint32_t last)
 {
     return TIMER_DIFF_32(timer_read32(), last);
 }
+
+/* no finer clock than the ms tick */
+uint16_t timer_read_ticks(void)
+{
+    return timer_read();
+}
+
+uint32_t timer_ticks_to_us(uint32_t ticks)
+{
+    return ticks * 1000;
+}
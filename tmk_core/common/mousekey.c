@@ -111,12 +111,6 @@ void mousekey_task(void)
     if (mouse_report.y > 0) mouse_report.y = move_unit();
     if (mouse_report.y < 0) mouse_report.y = move_unit() * -1;
 
-    /* diagonal move [1/sqrt(2) = 0.7] */
-    if (mouse_report.x && mouse_report.y) {
-        mouse_report.x *= 0.7;
-        mouse_report.y *= 0.7;
-    }
-
     if (mouse_report.v > 0) mouse_report.v = wheel_unit();
     if (mouse_report.v < 0) mouse_report.v = wheel_unit() * -1;
     if (mouse_report.h > 0) mouse_report.h = wheel_unit();
@@ -170,8 +164,18 @@ void mousekey_off(uint8_t code)
 
 void mousekey_send(void)
 {
+    int16_t x = mouse_report.x * HOST_MOUSE_SUBUNITS;
+    int16_t y = mouse_report.y * HOST_MOUSE_SUBUNITS;
+
+    /* diagonal move [1/sqrt(2) = 181/256], host.c keeps the fraction */
+    if (x && y) {
+        x = (int32_t)x * 181 / 256;
+        y = (int32_t)y * 181 / 256;
+    }
+
     mousekey_debug();
-    host_mouse_send(&mouse_report);
+    host_mouse_buttons(mouse_report.buttons);
+    host_mouse_move(x, y, mouse_report.v * HOST_MOUSE_SUBUNITS, mouse_report.h * HOST_MOUSE_SUBUNITS);
     last_timer = timer_read();
 }
 
@@ -0,0 +1,67 @@
+#include <stdint.h>
+#include "print.h"
+#include "profile.h"
+
+#if defined(__AVR__)
+#   ifndef PROFILE_BUCKETS
+#       define PROFILE_BUCKETS 128
+#   endif
+/* return addresses on AVR count words */
+#   define PROFILE_PC_ADDRESS(pc)  ((uint32_t)(pc) << 1)
+#else
+#   ifndef PROFILE_BUCKETS
+#       define PROFILE_BUCKETS 256
+#   endif
+#   define PROFILE_PC_ADDRESS(pc)  ((uint32_t)(pc))
+#endif
+
+#ifndef PROFILE_BUCKET_SHIFT
+#define PROFILE_BUCKET_SHIFT 8
+#endif
+
+uint32_t profile_base = 0;
+
+static volatile uint16_t profile_buckets[PROFILE_BUCKETS];
+static volatile uint16_t profile_other;
+static volatile uint32_t profile_samples;
+
+void profile_init(void)
+{
+    profile_clear();
+    profile_timer_init();
+}
+
+__attribute__ ((used))
+void profile_sample(uint32_t pc)
+{
+    uint32_t bucket = (PROFILE_PC_ADDRESS(pc) - profile_base) >> PROFILE_BUCKET_SHIFT;
+    if (bucket < PROFILE_BUCKETS) {
+        if (profile_buckets[bucket] < UINT16_MAX) profile_buckets[bucket]++;
+    } else {
+        if (profile_other < UINT16_MAX) profile_other++;
+    }
+    profile_samples++;
+}
+
+/* "#P" lines for profile_report.py: a header, then address and count of
+ * every bucket with samples */
+void profile_print(void)
+{
+    print("\n\t- Profile -\n");
+    xprintf("#P base %lX shift %u samples %lu other %u\n",
+            profile_base, PROFILE_BUCKET_SHIFT, profile_samples, profile_other);
+    for (uint16_t i = 0; i < PROFILE_BUCKETS; i++) {
+        if (!profile_buckets[i]) continue;
+        xprintf("#P %lX %u\n", profile_base + ((uint32_t)i << PROFILE_BUCKET_SHIFT), profile_buckets[i]);
+    }
+    print("#P end\n");
+}
+
+void profile_clear(void)
+{
+    for (uint16_t i = 0; i < PROFILE_BUCKETS; i++) {
+        profile_buckets[i] = 0;
+    }
+    profile_other = 0;
+    profile_samples = 0;
+}
@@ -0,0 +1,51 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+
+/*
+ * Sampling profiler
+ *
+ * A timer interrupt that nothing else uses samples the interrupted program
+ * counter about every ms into a histogram of 1 << PROFILE_BUCKET_SHIFT byte
+ * buckets. The profile command key prints the buckets to the console and
+ * tmk_core/tool/profile_report.py turns them into a flat profile with the
+ * .map file of the build.
+ *
+ * AVR samples with Timer1, or Timer3 with PROFILE_TIMER 3. Backlight takes
+ * Timer1 and audio and fauxclicky take Timer3, the build stops if the one
+ * picked is taken. ChibiOS
+ * samples from a virtual timer and can't see interrupt handlers, their time
+ * is counted for the thread they interrupted.
+ */
+
+#ifdef SAMPLE_PROFILE_ENABLE
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void profile_init(void);
+void profile_print(void);
+void profile_clear(void);
+
+/* called from the timer interrupt */
+void profile_sample(uint32_t pc);
+void profile_timer_init(void);
+
+/* address of the first bucket */
+extern uint32_t profile_base;
+
+#ifdef __cplusplus
+}
+#endif
+
+#else
+
+#define profile_init()
+#define profile_print()
+#define profile_clear()
+
+#endif
+
+#endif
@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include "quantum.h"
+#include "host.h"
+#include "host_driver.h"
+#include "action_tapping.h"
+#include "process_combo.h"
+#include "process_tap_dance.h"
+#include "bench.h"
+
+/* The event pipeline from action_exec() down to the host driver, on a
+ * 4x4 keymap. Time is faked: every event is TAPPING_TERM / 10 ms after the
+ * previous one, so tapping sees quick taps unless a benchmark waits.
+ */
+
+enum { BENCH_TD_A };
+
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    {
+        { KC_A,    KC_B,    KC_C,          KC_D },
+        { MO(1),   LT(1, KC_SPC), CTL_T(KC_ESC), KC_LSFT },
+        { TD(BENCH_TD_A), KC_J, KC_K,      KC_L },
+        { KC_1,    KC_2,    KC_3,          KC_4 },
+    },
+    {
+        { KC_TRNS, KC_TRNS, KC_TRNS,       KC_TRNS },
+        { KC_TRNS, KC_TRNS, KC_TRNS,       KC_TRNS },
+        { KC_TRNS, KC_TRNS, KC_TRNS,       KC_TRNS },
+        { KC_F1,   KC_F2,   KC_F3,         KC_F4 },
+    },
+};
+
+qk_tap_dance_action_t tap_dance_actions[] = {
+    [BENCH_TD_A] = ACTION_TAP_DANCE_DOUBLE(KC_A, KC_CAPS),
+};
+
+const uint16_t PROGMEM bench_combo_jk[] = { KC_J, KC_K, COMBO_END };
+combo_t key_combos[COMBO_COUNT] = {
+    COMBO(bench_combo_jk, KC_ESC),
+};
+
+/* what quantum.c, bootmagic.c and timer.c would provide */
+keymap_config_t keymap_config;
+
+static uint16_t fake_time;
+
+uint16_t timer_read(void) { return fake_time; }
+uint32_t timer_read32(void) { return fake_time; }
+uint16_t timer_elapsed(uint16_t last) { return TIMER_DIFF_16(fake_time, last); }
+uint32_t timer_elapsed32(uint32_t last) { return TIMER_DIFF_32(fake_time, last); }
+
+void register_code16(uint16_t code) { register_code(code); }
+void unregister_code16(uint16_t code) { unregister_code(code); }
+
+bool process_record_quantum(keyrecord_t *record)
+{
+    uint16_t keycode = keymap_key_to_keycode(layer_switch_get_layer(record->event.key), record->event.key);
+    return process_combo(keycode, record) && process_tap_dance(keycode, record);
+}
+
+static uint32_t reports_sent;
+
+static uint8_t null_leds(void) { return 0; }
+static void null_keyboard(report_keyboard_t *report) { (void)report; reports_sent++; }
+static void null_mouse(report_mouse_t *report) { (void)report; }
+static void null_system(uint16_t data) { (void)data; }
+static void null_consumer(uint16_t data) { (void)data; }
+
+static host_driver_t null_driver = {
+    null_leds, null_keyboard, null_mouse, null_system, null_consumer
+};
+
+static void event(uint8_t row, uint8_t col, bool pressed)
+{
+    fake_time += TAPPING_TERM / 10;
+    action_exec((keyevent_t){ .key = { .row = row, .col = col }, .pressed = pressed, .time = fake_time | 1 });
+}
+
+static void tick(void)
+{
+    fake_time += TAPPING_TERM / 10;
+    action_exec(TICK);
+}
+
+static void reset(void)
+{
+    host_set_driver(&null_driver);
+    clear_keyboard();
+    layer_clear();
+    for (int i = 0; i < 4; i++) tick();
+}
+
+/* benchmarks */
+
+static void bench_tick(void) { tick(); }
+
+static void bench_tap_key(void)
+{
+    event(0, 0, true);
+    event(0, 0, false);
+}
+
+static void bench_roll_two_keys(void)
+{
+    event(0, 0, true);
+    event(0, 1, true);
+    event(0, 0, false);
+    event(0, 1, false);
+}
+
+static void bench_hold_modifier(void)
+{
+    event(1, 3, true);
+    event(0, 0, true);
+    event(0, 0, false);
+    event(1, 3, false);
+}
+
+static void bench_momentary_layer(void)
+{
+    event(1, 0, true);
+    event(3, 0, true);
+    event(3, 0, false);
+    event(1, 0, false);
+}
+
+static void bench_layer_tap_tap(void)
+{
+    event(1, 1, true);
+    event(1, 1, false);
+    tick();
+}
+
+static void bench_mod_tap_hold(void)
+{
+    event(1, 2, true);
+    for (int i = 0; i < 10; i++) tick();
+    event(0, 0, true);
+    event(0, 0, false);
+    event(1, 2, false);
+}
+
+/* printed at the end so the lookups are not optimized away */
+static uint16_t action_checksum = 0;
+
+static void bench_layer_switch_get_action(void)
+{
+    action_checksum += layer_switch_get_action((keypos_t){ .row = 3, .col = 3 }).code;
+}
+
+static void bench_send_keyboard_report(void)
+{
+    add_key(KC_A);
+    send_keyboard_report();
+    del_key(KC_A);
+    send_keyboard_report();
+}
+
+static void bench_combo(void)
+{
+    event(2, 1, true);
+    event(2, 2, true);
+    event(2, 1, false);
+    event(2, 2, false);
+}
+
+static void bench_tap_dance_double(void)
+{
+    event(2, 0, true);
+    event(2, 0, false);
+    event(2, 0, true);
+    event(2, 0, false);
+    for (int i = 0; i < 12; i++) tick();
+}
+
+static const bench_t benches[] = {
+    BENCH(tick, reset),
+    BENCH(tap_key, reset),
+    BENCH(roll_two_keys, reset),
+    BENCH(hold_modifier, reset),
+    BENCH(momentary_layer, reset),
+    BENCH(layer_tap_tap, reset),
+    BENCH(mod_tap_hold, reset),
+    BENCH(layer_switch_get_action, reset),
+    BENCH(send_keyboard_report, reset),
+    BENCH(combo, reset),
+    BENCH(tap_dance_double, reset),
+};
+
+int main(int argc, char **argv)
+{
+    int result = bench_main(argc, argv, benches, sizeof(benches) / sizeof(benches[0]));
+    printf("%lu keyboard reports\n", (unsigned long)reports_sent);
+    printf("action checksum %04X\n", action_checksum);
+    return result;
+}
@@ -0,0 +1,137 @@
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include <string>
+#include <vector>
+
+using testing::ElementsAre;
+using testing::EndsWith;
+using testing::IsEmpty;
+
+extern "C" {
+#include "keycode.h"
+#include "action_macro.h"
+}
+
+/* The macro player is tested against a fake clock and fake report
+ * functions, each of which logs what it was called with and when.
+ */
+static uint16_t fake_time;
+static bool clock_running;
+static std::vector<std::string> sent;
+
+static void log_call(const char* what, uint8_t code) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%u %s %02X", fake_time, what, code);
+    sent.push_back(buffer);
+}
+
+extern "C" {
+uint16_t timer_read(void) { return clock_running ? fake_time++ : fake_time; }
+void register_code(uint8_t code) { log_call("down", code); }
+void unregister_code(uint8_t code) { log_call("up", code); }
+void add_macro_mods(uint8_t mods) { log_call("mods+", mods); }
+void del_macro_mods(uint8_t mods) { log_call("mods-", mods); }
+void send_keyboard_report(void) {}
+}
+
+class ActionMacro : public testing::Test {
+public:
+    ActionMacro() {
+        fake_time = 1000;
+        clock_running = false;
+        sent.clear();
+    }
+
+    ~ActionMacro() {
+        clock_running = false;
+        run_for(2000);
+    }
+
+    void run_for(uint16_t ms) {
+        for (uint16_t i = 0; i < ms; i++) {
+            action_macro_task();
+            fake_time++;
+        }
+    }
+
+    keypos_t key(uint8_t row, uint8_t col) {
+        return (keypos_t){ .col = col, .row = row };
+    }
+};
+
+TEST_F(ActionMacro, MacroWithoutDelaysPlaysImmediately) {
+    action_macro_play(MACRO(T(A), D(LSFT), T(B), U(LSFT), END));
+    EXPECT_FALSE(action_macro_is_playing());
+    EXPECT_THAT(sent, ElementsAre(
+        "1000 down 04", "1000 up 04",
+        "1000 mods+ 02",
+        "1000 down 05", "1000 up 05",
+        "1000 mods- 02"));
+}
+
+TEST_F(ActionMacro, WaitYieldsUntilItHasPassed) {
+    action_macro_play(MACRO(D(A), W(50), U(A), END));
+    EXPECT_THAT(sent, ElementsAre("1000 down 04"));
+    EXPECT_TRUE(action_macro_is_playing());
+    run_for(50);
+    EXPECT_THAT(sent, ElementsAre("1000 down 04"));
+    run_for(1);
+    EXPECT_THAT(sent, ElementsAre("1000 down 04", "1050 up 04"));
+    EXPECT_FALSE(action_macro_is_playing());
+}
+
+TEST_F(ActionMacro, IntervalIsAppliedAfterEveryCommand) {
+    action_macro_play(MACRO(I(10), T(A), W(5), T(B), END));
+    run_for(100);
+    EXPECT_THAT(sent, ElementsAre(
+        "1010 down 04", "1020 up 04",
+        "1045 down 05", "1055 up 05"));
+}
+
+TEST_F(ActionMacro, SlowLoopDoesNotStretchTheMacro) {
+    action_macro_play(MACRO(I(10), T(A), T(B), END));
+    fake_time += 55;
+    action_macro_task();
+    action_macro_task();
+    action_macro_task();
+    action_macro_task();
+    EXPECT_THAT(sent, ElementsAre(
+        "1055 down 04", "1055 up 04", "1055 down 05", "1055 up 05"));
+}
+
+TEST_F(ActionMacro, MacrosOfDifferentKeysPlayConcurrently) {
+    action_macro_play_key(key(0, 0), MACRO(D(A), W(20), U(A), END));
+    action_macro_play_key(key(0, 1), MACRO(D(B), W(10), U(B), END));
+    run_for(30);
+    EXPECT_THAT(sent, ElementsAre(
+        "1000 down 04", "1000 down 05", "1010 up 05", "1020 up 04"));
+}
+
+TEST_F(ActionMacro, MacrosOfTheSameKeyPlayInOrder) {
+    action_macro_play_key(key(2, 3), MACRO(D(LSFT), W(20), T(A), END));
+    action_macro_play_key(key(2, 3), MACRO(U(LSFT), END));
+    EXPECT_THAT(sent, ElementsAre("1000 mods+ 02"));
+    run_for(30);
+    EXPECT_THAT(sent, ElementsAre(
+        "1000 mods+ 02", "1020 down 04", "1020 up 04", "1020 mods- 02"));
+}
+
+TEST_F(ActionMacro, FullQueueFinishesAMacroFirst) {
+    for (uint8_t i = 0; i < ACTION_MACRO_PLAYERS; i++) {
+        action_macro_play_key(key(0, i), MACRO(W(5), T(A), END));
+    }
+    EXPECT_THAT(sent, IsEmpty());
+    // the player busy waits on the clock for a free slot
+    clock_running = true;
+    action_macro_play_key(key(1, 0), MACRO(T(B), END));
+    clock_running = false;
+    EXPECT_THAT(sent.front(), EndsWith("down 04"));
+    EXPECT_THAT(sent.back(), EndsWith("up 05"));
+}
+
+TEST_F(ActionMacro, NoMacroDoesNothing) {
+    action_macro_play(MACRO_NONE);
+    EXPECT_FALSE(action_macro_is_playing());
+    EXPECT_THAT(sent, IsEmpty());
+}
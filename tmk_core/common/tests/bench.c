@@ -0,0 +1,70 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "bench.h"
+
+#ifndef BENCH_MIN_NS
+#define BENCH_MIN_NS 50000000   // 50ms per run
+#endif
+
+#ifndef BENCH_RUNS
+#define BENCH_RUNS 5
+#endif
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint64_t time_run(const bench_t *bench, uint64_t iterations)
+{
+    if (bench->setup) bench->setup();
+    uint64_t start = now_ns();
+    for (uint64_t i = 0; i < iterations; i++) {
+        bench->run();
+    }
+    return now_ns() - start;
+}
+
+static void run_bench(const bench_t *bench)
+{
+    /* double the iterations until a run takes long enough to time */
+    uint64_t iterations = 1;
+    uint64_t elapsed;
+    while ((elapsed = time_run(bench, iterations)) < BENCH_MIN_NS / 8) {
+        iterations *= 2;
+    }
+    iterations = iterations * BENCH_MIN_NS / (elapsed ? elapsed : 1) + 1;
+
+    /* the fastest run has the least noise from the rest of the system */
+    uint64_t best = UINT64_MAX;
+    for (int i = 0; i < BENCH_RUNS; i++) {
+        elapsed = time_run(bench, iterations);
+        if (elapsed < best) best = elapsed;
+    }
+
+    printf("%-40s %12llu %10.1f ns/op\n", bench->name,
+           (unsigned long long)iterations, (double)best / iterations);
+}
+
+int bench_main(int argc, char **argv, const bench_t *benches, size_t count)
+{
+    const char *filter = argc > 1 ? argv[1] : NULL;
+    size_t ran = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        if (filter && !strstr(benches[i].name, filter)) continue;
+        run_bench(&benches[i]);
+        fflush(stdout);
+        ran++;
+    }
+
+    if (!ran) {
+        fprintf(stderr, "no benchmark matches '%s'\n", filter);
+        return 1;
+    }
+    return 0;
+}
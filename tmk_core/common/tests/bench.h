@@ -0,0 +1,29 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stddef.h>
+
+/*
+ * Native micro-benchmarks
+ *
+ * Each benchmark is a function doing one operation. bench_main() runs it
+ * in a loop long enough to time, keeps the best of a few runs and prints
+ * one line per benchmark:
+ *
+ *     name                              iterations      ns/op
+ *
+ * The first argument, when given, only runs the benchmarks whose name
+ * contains it.
+ */
+
+typedef struct {
+    const char *name;
+    void (*setup)(void);    // may be NULL
+    void (*run)(void);
+} bench_t;
+
+#define BENCH(name, setup) { #name, setup, bench_##name }
+
+int bench_main(int argc, char **argv, const bench_t *benches, size_t count);
+
+#endif
@@ -0,0 +1,22 @@
+tmk_core_action_macro_SRC := \
+	$(TMK_PATH)/common/tests/action_macro_tests.cpp \
+	$(TMK_PATH)/common/action_macro.c
+
+tmk_core_action_bench_SRC := \
+	$(TMK_PATH)/common/tests/action_bench.c \
+	$(TMK_PATH)/common/tests/bench.c \
+	$(TMK_PATH)/common/action.c \
+	$(TMK_PATH)/common/action_layer.c \
+	$(TMK_PATH)/common/action_tapping.c \
+	$(TMK_PATH)/common/action_util.c \
+	$(TMK_PATH)/common/action_macro.c \
+	$(TMK_PATH)/common/host.c \
+	$(TMK_PATH)/common/util.c \
+	$(QUANTUM_PATH)/keymap_common.c \
+	$(QUANTUM_PATH)/keycode_config.c \
+	$(QUANTUM_PATH)/process_keycode/process_combo.c \
+	$(QUANTUM_PATH)/process_keycode/process_tap_dance.c
+tmk_core_action_bench_DEFS := \
+	-DMATRIX_ROWS=4 -DMATRIX_COLS=4 -DTAPPING_TERM=200 \
+	-DNO_PRINT -DNO_DEBUG \
+	-DTAP_DANCE_ENABLE -DCOMBO_ENABLE -DCOMBO_COUNT=1
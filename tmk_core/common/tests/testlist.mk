@@ -0,0 +1,4 @@
+TEST_LIST +=\
+	tmk_core_action_macro
+BENCH_LIST +=\
+	tmk_core_action_bench
@@ -46,6 +46,10 @@ uint32_t timer_read32(void);
 uint16_t timer_elapsed(uint16_t last);
 uint32_t timer_elapsed32(uint32_t last);
 
+/* a finer clock where there is one, for timing things shorter than a ms */
+uint16_t timer_read_ticks(void);
+uint32_t timer_ticks_to_us(uint32_t ticks);
+
 #ifdef __cplusplus
 }
 #endif
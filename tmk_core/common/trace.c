@@ -0,0 +1,78 @@
+#include <stdint.h>
+#include "timer.h"
+#include "print.h"
+#include "trace.h"
+
+#ifndef TRACE_BUFFER_SIZE
+#define TRACE_BUFFER_SIZE 128
+#endif
+#if TRACE_BUFFER_SIZE > 255
+#error "TRACE_BUFFER_SIZE must be 255 or less"
+#endif
+
+/* records sent per trace_task() call */
+#ifndef TRACE_RECORDS_PER_TASK
+#define TRACE_RECORDS_PER_TASK 1
+#endif
+
+/* a record is id(2) time(2) argc(1) argv(2 * argc), little endian */
+#define TRACE_HEADER_SIZE 5
+
+static uint8_t trace_buffer[TRACE_BUFFER_SIZE];
+static uint8_t trace_head = 0;
+static uint8_t trace_count = 0;
+
+uint16_t trace_drops = 0;
+static uint16_t trace_drops_sent = 0;
+
+static void trace_put(uint8_t data)
+{
+    trace_buffer[(trace_head + trace_count) % TRACE_BUFFER_SIZE] = data;
+    trace_count++;
+}
+
+static uint8_t trace_get(void)
+{
+    uint8_t data = trace_buffer[trace_head];
+    trace_head = (trace_head + 1) % TRACE_BUFFER_SIZE;
+    trace_count--;
+    return data;
+}
+
+void trace_record(uint16_t id, uint8_t argc, const uint16_t *argv)
+{
+    if (argc > TRACE_ARGS_MAX) argc = TRACE_ARGS_MAX;
+    if (trace_count + TRACE_HEADER_SIZE + 2 * argc > TRACE_BUFFER_SIZE) {
+        trace_drops++;
+        return;
+    }
+
+    uint16_t time = timer_read();
+    trace_put(id);
+    trace_put(id >> 8);
+    trace_put(time);
+    trace_put(time >> 8);
+    trace_put(argc);
+    for (uint8_t i = 0; i < argc; i++) {
+        trace_put(argv[i]);
+        trace_put(argv[i] >> 8);
+    }
+}
+
+/* one "#T<hex bytes>" line per record */
+void trace_task(void)
+{
+    if (trace_drops != trace_drops_sent) {
+        xprintf("#trace lost %u\n", trace_drops - trace_drops_sent);
+        trace_drops_sent = trace_drops;
+    }
+
+    for (uint8_t n = 0; n < TRACE_RECORDS_PER_TASK && trace_count; n++) {
+        uint8_t size = TRACE_HEADER_SIZE + 2 * trace_buffer[(trace_head + 4) % TRACE_BUFFER_SIZE];
+        print("#T");
+        while (size--) {
+            print_hex8(trace_get());
+        }
+        print("\n");
+    }
+}
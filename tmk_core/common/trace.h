@@ -0,0 +1,53 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+/*
+ * Binary trace
+ *
+ * trace(fmt, ...) is a printf that doesn't format on the keyboard. It stores
+ * an id for fmt, a timer_read() timestamp and up to TRACE_ARGS_MAX 16 bit
+ * arguments in a RAM ring, and trace_task() sends the records to the console
+ * as hex lines. tmk_core/tool/trace_decode.py turns them back into text with
+ * the format strings from the .elf.
+ *
+ * The format strings go to the .trace_fmt section, which ldscript_trace.x
+ * keeps out of flash. The id of a record is the offset of its string there.
+ *
+ * Arguments are 16 bit, so %s and %l don't work. Not for interrupt handlers.
+ */
+
+#ifdef TRACE_ENABLE
+
+#define TRACE_ARGS_MAX 4
+
+#define trace(fmt, ...) do { \
+    static const char trace_fmt[] __attribute__((section(".trace_fmt"), used)) = fmt; \
+    const uint16_t trace_args[] = { 0, ##__VA_ARGS__ }; \
+    trace_record((uint16_t)(uintptr_t)trace_fmt, \
+                 sizeof(trace_args) / sizeof(trace_args[0]) - 1, &trace_args[1]); \
+} while (0)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void trace_record(uint16_t id, uint8_t argc, const uint16_t *argv);
+void trace_task(void);
+
+/* records lost to a full buffer */
+extern uint16_t trace_drops;
+
+#ifdef __cplusplus
+}
+#endif
+
+#else
+
+#define trace(fmt, ...)
+#define trace_task()
+
+#endif
+
+#endif
@@ -5,16 +5,22 @@
 extern "C" {
 #endif
 
+/* host.c, a keyboard report held back for the end of the scan goes out
+ * before waiting so the wait is seen by the host */
+void host_keyboard_flush(void);
+
 #if defined(__AVR__)
 #   include <util/delay.h>
-#   define wait_ms(ms)  _delay_ms(ms)
-#   define wait_us(us)  _delay_us(us)
+#   define wait_ms(ms)  do { host_keyboard_flush(); _delay_ms(ms); } while (0)
+#   define wait_us(us)  do { host_keyboard_flush(); _delay_us(us); } while (0)
 #elif defined(PROTOCOL_CHIBIOS) /* __AVR__ */
 #   include "ch.h"
-#   define wait_ms(ms) chThdSleepMilliseconds(ms)
-#   define wait_us(us) chThdSleepMicroseconds(us)
+#   define wait_ms(ms) do { host_keyboard_flush(); chThdSleepMilliseconds(ms); } while (0)
+#   define wait_us(us) do { host_keyboard_flush(); chThdSleepMicroseconds(us); } while (0)
 #elif defined(__arm__) /* __AVR__ */
 #   include "wait_api.h"
+#   define wait_ms(ms) do { host_keyboard_flush(); wait_ms(ms); } while (0)
+#   define wait_us(us) do { host_keyboard_flush(); wait_us(us); } while (0)
 #endif /* __AVR__ */
 
 #ifdef __cplusplus
@@ -0,0 +1,16 @@
+/*
+ * linker script for trace format strings
+ *
+ * Inserted into the default or board linker script. The format strings of
+ * trace() are kept in the .elf for tool/trace_decode.py but the section is
+ * not allocated, so it takes neither flash nor RAM. It starts at 0, the
+ * offset of a string is its trace id.
+ */
+SECTIONS
+{
+  .trace_fmt 0 (INFO) :
+  {
+    KEEP(*(.trace_fmt))
+  }
+}
+INSERT AFTER .comment;
@@ -20,8 +20,11 @@
 
 #include "usb_main.h"
 
+#include <string.h>
+
 #include "host.h"
 #include "debug.h"
+#include "print.h"
 #include "suspend.h"
 #ifdef SLEEP_LED_ENABLE
 #include "sleep_led.h"
@@ -54,6 +57,56 @@ report_mouse_t mouse_report_blank = {0};
 uint8_t extra_report_blank[3] = {0};
 #endif /* EXTRAKEY_ENABLE */
 
+/* ---------------------------------------------------------
+ *                      Report queues
+ * ---------------------------------------------------------
+ * send_keyboard/send_mouse/send_extra only copy the report into the queue
+ * of its endpoint and return, the IN callback of the endpoint starts the
+ * next transfer once the previous one made it through.
+ * The keyboard thread is the only one moving tail and the callbacks are the
+ * only ones moving head, the entry at head is the one on the wire.
+ */
+#ifndef REPORT_QUEUE_SIZE
+#define REPORT_QUEUE_SIZE 8
+#endif
+
+typedef struct {
+  usbep_t ep;
+  uint8_t size;                 /* bytes per report */
+  uint8_t *buf;                 /* REPORT_QUEUE_SIZE reports */
+  void *sent_copy;              /* gets each report the host has read, or NULL */
+  volatile uint8_t head;
+  volatile uint8_t tail;
+  volatile bool busy;           /* head is being transmitted */
+  systime_t queued[REPORT_QUEUE_SIZE];
+  /* statistics */
+  uint8_t depth_max;
+  uint16_t drops;
+  uint32_t sent;
+  uint32_t latency_sum;
+  systime_t latency_max;
+} report_queue_t;
+
+#define REPORT_QUEUE_NEXT(i) (((i) + 1) % REPORT_QUEUE_SIZE)
+#define REPORT_QUEUE_SLOT(q, i) (&(q)->buf[(i) * (q)->size])
+#define REPORT_QUEUE_INIT(endpoint, report_size, storage, copy) \
+  { .ep = (endpoint), .size = (report_size), .buf = (storage), .sent_copy = (copy) }
+
+static uint8_t kbd_queue_buf[REPORT_QUEUE_SIZE * KBD_EPSIZE];
+static report_queue_t kbd_queue = REPORT_QUEUE_INIT(KBD_ENDPOINT, KBD_EPSIZE, kbd_queue_buf, &keyboard_report_sent);
+#ifdef NKRO_ENABLE
+static uint8_t nkro_queue_buf[REPORT_QUEUE_SIZE * sizeof(report_keyboard_t)];
+static report_queue_t nkro_queue = REPORT_QUEUE_INIT(NKRO_ENDPOINT, sizeof(report_keyboard_t), nkro_queue_buf, &keyboard_report_sent);
+#endif /* NKRO_ENABLE */
+#ifdef MOUSE_ENABLE
+static uint8_t mouse_queue_buf[REPORT_QUEUE_SIZE * sizeof(report_mouse_t)];
+static report_queue_t mouse_queue = REPORT_QUEUE_INIT(MOUSE_ENDPOINT, sizeof(report_mouse_t), mouse_queue_buf, NULL);
+#endif /* MOUSE_ENABLE */
+#ifdef EXTRAKEY_ENABLE
+static uint8_t extra_queue_buf[REPORT_QUEUE_SIZE * sizeof(report_extra_t)];
+static report_queue_t extra_queue = REPORT_QUEUE_INIT(EXTRA_ENDPOINT, sizeof(report_extra_t), extra_queue_buf, NULL);
+#endif /* EXTRAKEY_ENABLE */
+
 #ifdef CONSOLE_ENABLE
 /* The emission buffers queue */
 output_buffers_queue_t console_buf_queue;
@@ -386,7 +439,7 @@ static const uint8_t hid_configuration_descriptor_data[] = {
   USB_DESC_ENDPOINT(KBD_ENDPOINT | 0x80,  // bEndpointAddress
                     0x03,      // bmAttributes (Interrupt)
                     KBD_EPSIZE,// wMaxPacketSize
-                    10),       // bInterval
+                    KEYBOARD_POLLING_INTERVAL), // bInterval
 
   #ifdef MOUSE_ENABLE
   /* Interface Descriptor (9 bytes) USB spec 9.6.5, page 267-269, Table 9-12 */
@@ -416,7 +469,7 @@ static const uint8_t hid_configuration_descriptor_data[] = {
   USB_DESC_ENDPOINT(MOUSE_ENDPOINT | 0x80,  // bEndpointAddress
                     0x03,      // bmAttributes (Interrupt)
                     MOUSE_EPSIZE,  // wMaxPacketSize
-                    1),        // bInterval
+                    MOUSE_POLLING_INTERVAL), // bInterval
   #endif /* MOUSE_ENABLE */
 
   #ifdef CONSOLE_ENABLE
@@ -468,7 +521,7 @@ static const uint8_t hid_configuration_descriptor_data[] = {
   USB_DESC_ENDPOINT(EXTRA_ENDPOINT | 0x80,  // bEndpointAddress
                     0x03,      // bmAttributes (Interrupt)
                     EXTRA_EPSIZE, // wMaxPacketSize
-                    10),       // bInterval
+                    EXTRAKEY_POLLING_INTERVAL), // bInterval
   #endif /* EXTRAKEY_ENABLE */
 
   #ifdef NKRO_ENABLE
@@ -494,7 +547,7 @@ static const uint8_t hid_configuration_descriptor_data[] = {
   USB_DESC_ENDPOINT(NKRO_ENDPOINT | 0x80,  // bEndpointAddress
                     0x03,      // bmAttributes (Interrupt)
                     NKRO_EPSIZE, // wMaxPacketSize
-                    1),       // bInterval
+                    NKRO_POLLING_INTERVAL), // bInterval
   #endif /* NKRO_ENABLE */
 };
 
@@ -760,6 +813,144 @@ static const USBEndpointConfig nkro_ep_config = {
 };
 #endif /* NKRO_ENABLE */
 
+/* ---------------------------------------------------------
+ *                  Report queue functions
+ * ---------------------------------------------------------
+ */
+
+static uint8_t report_queue_depth(report_queue_t *q) {
+  return (q->tail + REPORT_QUEUE_SIZE - q->head) % REPORT_QUEUE_SIZE;
+}
+
+/* called with the queue idle, when the endpoint is (re)initialised */
+static void report_queue_reset_i(report_queue_t *q) {
+  q->head = q->tail;
+  q->busy = false;
+}
+
+/* start sending the report at head if the endpoint is free
+ * (I-class, the idle timer may be using the keyboard endpoint) */
+static void report_queue_kick_i(USBDriver *usbp, report_queue_t *q) {
+  if(q->busy || q->head == q->tail || usbGetTransmitStatusI(usbp, q->ep)) {
+    return;
+  }
+  q->busy = true;
+  usbStartTransmitI(usbp, q->ep, REPORT_QUEUE_SLOT(q, q->head), q->size);
+}
+
+/* queue a report, never waits for the host
+ * merge(pending, report) may fold the report into the last queued one when
+ * the queue is full, otherwise that one is overwritten and counted as dropped */
+static void report_queue_push(report_queue_t *q, const void *report, bool (*merge)(void *pending, const void *report)) {
+  uint8_t next = REPORT_QUEUE_NEXT(q->tail);
+
+  osalSysLock();
+  if(usbGetDriverStateI(&USB_DRIVER) != USB_ACTIVE) {
+    osalSysUnlock();
+    return;
+  }
+  if(next == q->head) {
+    /* full: the newest queued report is never the one on the wire */
+    uint8_t last = (q->tail + REPORT_QUEUE_SIZE - 1) % REPORT_QUEUE_SIZE;
+    if(!merge || !merge(REPORT_QUEUE_SLOT(q, last), report)) {
+      memcpy(REPORT_QUEUE_SLOT(q, last), report, q->size);
+      q->drops++;
+    }
+    osalSysUnlock();
+    return;
+  }
+  osalSysUnlock();
+
+  /* the slot at tail belongs to this thread until tail moves */
+  memcpy(REPORT_QUEUE_SLOT(q, q->tail), report, q->size);
+  q->queued[q->tail] = chVTGetSystemTimeX();
+
+  osalSysLock();
+  q->tail = next;
+  uint8_t depth = report_queue_depth(q);
+  if(depth > q->depth_max) {
+    q->depth_max = depth;
+  }
+  report_queue_kick_i(&USB_DRIVER, q);
+  osalSysUnlock();
+}
+
+/* IN callback side: the report at head made it, send the next one */
+static void report_queue_sent(USBDriver *usbp, report_queue_t *q) {
+  osalSysLockFromISR();
+  if(q->busy) {
+    systime_t latency = chVTGetSystemTimeX() - q->queued[q->head];
+    q->latency_sum += latency;
+    if(latency > q->latency_max) {
+      q->latency_max = latency;
+    }
+    q->sent++;
+    if(q->sent_copy) {
+      memcpy(q->sent_copy, REPORT_QUEUE_SLOT(q, q->head), q->size);
+    }
+    q->busy = false;
+    q->head = REPORT_QUEUE_NEXT(q->head);
+  }
+  report_queue_kick_i(usbp, q);
+  osalSysUnlockFromISR();
+}
+
+static void report_queue_print(const char *name, report_queue_t *q) {
+  xprintf("%s: sent %lu, depth %u/%u, drops %u, latency avg %luus max %luus\n",
+          name, (unsigned long)q->sent, report_queue_depth(q), q->depth_max, q->drops,
+          (unsigned long)(q->sent ? ST2US(q->latency_sum / q->sent) : 0),
+          (unsigned long)ST2US(q->latency_max));
+}
+
+/* print queue depth and latency (queued to transmitted) of every endpoint */
+void usb_report_queue_stats(void) {
+  report_queue_print("kbd", &kbd_queue);
+#ifdef NKRO_ENABLE
+  report_queue_print("nkro", &nkro_queue);
+#endif /* NKRO_ENABLE */
+#ifdef MOUSE_ENABLE
+  report_queue_print("mouse", &mouse_queue);
+#endif /* MOUSE_ENABLE */
+#ifdef EXTRAKEY_ENABLE
+  report_queue_print("extra", &extra_queue);
+#endif /* EXTRAKEY_ENABLE */
+}
+
+#ifndef USB_LATENCY_TEST_REPORTS
+#define USB_LATENCY_TEST_REPORTS 32
+#endif
+
+/* Sends copies of the current keyboard report, which the host ignores, one
+ * at a time and prints how long they waited to be picked up by the host.
+ * not callable from ISR or locked state */
+void usb_latency_test(void) {
+  report_queue_t *q = &kbd_queue;
+  uint8_t interval = KEYBOARD_POLLING_INTERVAL;
+#ifdef NKRO_ENABLE
+  if(keymap_config.nkro) {
+    q = &nkro_queue;
+    interval = NKRO_POLLING_INTERVAL;
+  }
+#endif /* NKRO_ENABLE */
+
+  osalSysLock();
+  q->sent = 0;
+  q->latency_sum = 0;
+  q->latency_max = 0;
+  osalSysUnlock();
+
+  report_keyboard_t report = keyboard_report_sent;
+  for(uint8_t i = 0; i < USB_LATENCY_TEST_REPORTS; i++) {
+    report_queue_push(q, &report, NULL);
+    /* give up on a host that stopped polling */
+    for(uint16_t t = 0; t < 1000 && q->head != q->tail; t++) {
+      chThdSleepMilliseconds(1);
+    }
+  }
+  xprintf("bInterval: %ums\n", interval);
+  report_queue_print("latency", q);
+}
+
 /* ---------------------------------------------------------
  *                  USB driver functions
  * ---------------------------------------------------------
@@ -779,8 +970,10 @@ static void usb_event_cb(USBDriver *usbp, usbevent_t event) {
   case USB_EVENT_CONFIGURED:
     osalSysLockFromISR();
     /* Enable the endpoints specified into the configuration. */
+    report_queue_reset_i(&kbd_queue);
     usbInitEndpointI(usbp, KBD_ENDPOINT, &kbd_ep_config);
 #ifdef MOUSE_ENABLE
+    report_queue_reset_i(&mouse_queue);
     usbInitEndpointI(usbp, MOUSE_ENDPOINT, &mouse_ep_config);
 #endif /* MOUSE_ENABLE */
 #ifdef CONSOLE_ENABLE
@@ -788,9 +981,11 @@ static void usb_event_cb(USBDriver *usbp, usbevent_t event) {
     /* don't need to start the flush timer, it starts from console_in_cb automatically */
 #endif /* CONSOLE_ENABLE */
 #ifdef EXTRAKEY_ENABLE
+    report_queue_reset_i(&extra_queue);
     usbInitEndpointI(usbp, EXTRA_ENDPOINT, &extra_ep_config);
 #endif /* EXTRAKEY_ENABLE */
 #ifdef NKRO_ENABLE
+    report_queue_reset_i(&nkro_queue);
     usbInitEndpointI(usbp, NKRO_ENDPOINT, &nkro_ep_config);
 #endif /* NKRO_ENABLE */
     osalSysUnlockFromISR();
@@ -1056,17 +1251,15 @@ void send_remote_wakeup(USBDriver *usbp) {
 
 /* keyboard IN callback hander (a kbd report has made it IN) */
 void kbd_in_cb(USBDriver *usbp, usbep_t ep) {
-  /* STUB */
-  (void)usbp;
   (void)ep;
+  report_queue_sent(usbp, &kbd_queue);
 }
 
 #ifdef NKRO_ENABLE
 /* nkro IN callback hander (a nkro report has made it IN) */
 void nkro_in_cb(USBDriver *usbp, usbep_t ep) {
-  /* STUB */
-  (void)usbp;
   (void)ep;
+  report_queue_sent(usbp, &nkro_queue);
 }
 #endif /* NKRO_ENABLE */
 
@@ -1114,50 +1307,18 @@ uint8_t keyboard_leds(void) {
   return (uint8_t)(keyboard_led_stats & 0xFF);
 }
 
-/* prepare and start sending a report IN
+/* queue a report, it is sent from kbd_in_cb/nkro_in_cb
  * not callable from ISR or locked state */
 void send_keyboard(report_keyboard_t *report) {
-  osalSysLock();
-  if(usbGetDriverStateI(&USB_DRIVER) != USB_ACTIVE) {
-    osalSysUnlock();
-    return;
-  }
-  osalSysUnlock();
-
 #ifdef NKRO_ENABLE
   if(keymap_config.nkro) {  /* NKRO protocol */
-    /* need to wait until the previous packet has made it through */
-    /* can rewrite this using the synchronous API, then would wait
-     * until *after* the packet has been transmitted. I think
-     * this is more efficient */
-    /* busy wait, should be short and not very common */
-    osalSysLock();
-    if(usbGetTransmitStatusI(&USB_DRIVER, NKRO_ENDPOINT)) {
-      /* Need to either suspend, or loop and call unlock/lock during
-       * every iteration - otherwise the system will remain locked,
-       * no interrupts served, so USB not going through as well.
-       * Note: for suspend, need USB_USE_WAIT == TRUE in halconf.h */
-      osalThreadSuspendS(&(&USB_DRIVER)->epc[NKRO_ENDPOINT]->in_state->thread);
-    }
-    usbStartTransmitI(&USB_DRIVER, NKRO_ENDPOINT, (uint8_t *)report, sizeof(report_keyboard_t));
-    osalSysUnlock();
+    report_queue_push(&nkro_queue, report, NULL);
   } else
 #endif /* NKRO_ENABLE */
   { /* boot protocol */
-    /* need to wait until the previous packet has made it through */
-    /* busy wait, should be short and not very common */
-    osalSysLock();
-    if(usbGetTransmitStatusI(&USB_DRIVER, KBD_ENDPOINT)) {
-      /* Need to either suspend, or loop and call unlock/lock during
-       * every iteration - otherwise the system will remain locked,
-       * no interrupts served, so USB not going through as well.
-       * Note: for suspend, need USB_USE_WAIT == TRUE in halconf.h */
-      osalThreadSuspendS(&(&USB_DRIVER)->epc[KBD_ENDPOINT]->in_state->thread);
-    }
-    usbStartTransmitI(&USB_DRIVER, KBD_ENDPOINT, (uint8_t *)report, KBD_EPSIZE);
-    osalSysUnlock();
+    report_queue_push(&kbd_queue, report, NULL);
   }
-  keyboard_report_sent = *report;
+  /* keyboard_report_sent, for GET_REPORT and idle, follows in kbd_in_cb/nkro_in_cb */
 }
 
 /* ---------------------------------------------------------
@@ -1169,26 +1330,31 @@ void send_keyboard(report_keyboard_t *report) {
 
 /* mouse IN callback hander (a mouse report has made it IN) */
 void mouse_in_cb(USBDriver *usbp, usbep_t ep) {
-  (void)usbp;
   (void)ep;
+  report_queue_sent(usbp, &mouse_queue);
 }
 
-void send_mouse(report_mouse_t *report) {
-  osalSysLock();
-  if(usbGetDriverStateI(&USB_DRIVER) != USB_ACTIVE) {
-    osalSysUnlock();
-    return;
-  }
-  osalSysUnlock();
+static int8_t mouse_add(int8_t a, int8_t b) {
+  int16_t sum = a + b;
+  return sum > 127 ? 127 : (sum < -127 ? -127 : sum);
+}
 
-  /* TODO: LUFA manually waits for the endpoint to become ready
-   * for about 10ms for mouse, kbd, system; 1ms for nkro
-   * is this really needed?
-   */
+/* movement with the same buttons adds up instead of getting lost */
+static bool mouse_merge(void *pending, const void *report) {
+  report_mouse_t *p = (report_mouse_t *)pending;
+  const report_mouse_t *r = (const report_mouse_t *)report;
+  if(p->buttons != r->buttons) {
+    return false;
+  }
+  p->x = mouse_add(p->x, r->x);
+  p->y = mouse_add(p->y, r->y);
+  p->v = mouse_add(p->v, r->v);
+  p->h = mouse_add(p->h, r->h);
+  return true;
+}
 
-  osalSysLock();
-  usbStartTransmitI(&USB_DRIVER, MOUSE_ENDPOINT, (uint8_t *)report, sizeof(report_mouse_t));
-  osalSysUnlock();
+void send_mouse(report_mouse_t *report) {
+  report_queue_push(&mouse_queue, report, mouse_merge);
 }
 
 #else /* MOUSE_ENABLE */
@@ -1206,25 +1372,17 @@ void send_mouse(report_mouse_t *report) {
 
 /* extrakey IN callback hander */
 void extra_in_cb(USBDriver *usbp, usbep_t ep) {
-  /* STUB */
-  (void)usbp;
   (void)ep;
+  report_queue_sent(usbp, &extra_queue);
 }
 
 static void send_extra_report(uint8_t report_id, uint16_t data) {
-  osalSysLock();
-  if(usbGetDriverStateI(&USB_DRIVER) != USB_ACTIVE) {
-    osalSysUnlock();
-    return;
-  }
-
   report_extra_t report = {
     .report_id = report_id,
     .usage = data
   };
 
-  usbStartTransmitI(&USB_DRIVER, EXTRA_ENDPOINT, (uint8_t *)&report, sizeof(report_extra_t));
-  osalSysUnlock();
+  report_queue_push(&extra_queue, &report, NULL);
 }
 
 void send_system(uint16_t data) {
@@ -39,6 +39,52 @@ void init_usb_driver(USBDriver *usbp);
 /* Send remote wakeup packet */
 void send_remote_wakeup(USBDriver *usbp);
 
+/* Print report queue statistics on the console */
+void usb_report_queue_stats(void);
+
+/* Measure how long keyboard reports wait for the host and print it */
+void usb_latency_test(void);
+
+/* ---------------
+ * Polling intervals
+ * ---------------
+ */
+
+/* bInterval of the HID endpoints in ms, 1 to 255.
+ * USB_POLLING_INTERVAL sets all of them, 1 polls at 1kHz. */
+#ifdef USB_POLLING_INTERVAL
+#ifndef KEYBOARD_POLLING_INTERVAL
+#define KEYBOARD_POLLING_INTERVAL USB_POLLING_INTERVAL
+#endif
+#ifndef MOUSE_POLLING_INTERVAL
+#define MOUSE_POLLING_INTERVAL    USB_POLLING_INTERVAL
+#endif
+#ifndef EXTRAKEY_POLLING_INTERVAL
+#define EXTRAKEY_POLLING_INTERVAL USB_POLLING_INTERVAL
+#endif
+#ifndef NKRO_POLLING_INTERVAL
+#define NKRO_POLLING_INTERVAL     USB_POLLING_INTERVAL
+#endif
+#endif /* USB_POLLING_INTERVAL */
+#ifndef KEYBOARD_POLLING_INTERVAL
+#define KEYBOARD_POLLING_INTERVAL 10
+#endif
+#ifndef MOUSE_POLLING_INTERVAL
+#define MOUSE_POLLING_INTERVAL    1
+#endif
+#ifndef EXTRAKEY_POLLING_INTERVAL
+#define EXTRAKEY_POLLING_INTERVAL 10
+#endif
+#ifndef NKRO_POLLING_INTERVAL
+#define NKRO_POLLING_INTERVAL     1
+#endif
+#if KEYBOARD_POLLING_INTERVAL < 1 || KEYBOARD_POLLING_INTERVAL > 255 || \
+    MOUSE_POLLING_INTERVAL < 1 || MOUSE_POLLING_INTERVAL > 255 || \
+    EXTRAKEY_POLLING_INTERVAL < 1 || EXTRAKEY_POLLING_INTERVAL > 255 || \
+    NKRO_POLLING_INTERVAL < 1 || NKRO_POLLING_INTERVAL > 255
+#error "USB polling intervals must be between 1 and 255 ms"
+#endif
+
 /* ---------------
  * Keyboard header
  * ---------------
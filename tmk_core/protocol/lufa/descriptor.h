@@ -242,6 +242,41 @@ typedef struct
 # error "Endpoints are not available enough to support all functions. Remove some in Makefile.(MOUSEKEY, EXTRAKEY, CONSOLE, NKRO, MIDI, SERIAL)"
 #endif
 
+/* Polling interval (bInterval) of the HID endpoints in ms, 1 to 255.
+ * USB_POLLING_INTERVAL sets all of them, 1 polls at 1kHz. */
+#ifdef USB_POLLING_INTERVAL
+#   ifndef KEYBOARD_POLLING_INTERVAL
+#       define KEYBOARD_POLLING_INTERVAL    USB_POLLING_INTERVAL
+#   endif
+#   ifndef MOUSE_POLLING_INTERVAL
+#       define MOUSE_POLLING_INTERVAL       USB_POLLING_INTERVAL
+#   endif
+#   ifndef EXTRAKEY_POLLING_INTERVAL
+#       define EXTRAKEY_POLLING_INTERVAL    USB_POLLING_INTERVAL
+#   endif
+#   ifndef NKRO_POLLING_INTERVAL
+#       define NKRO_POLLING_INTERVAL        USB_POLLING_INTERVAL
+#   endif
+#endif
+#ifndef KEYBOARD_POLLING_INTERVAL
+#   define KEYBOARD_POLLING_INTERVAL    10
+#endif
+#ifndef MOUSE_POLLING_INTERVAL
+#   define MOUSE_POLLING_INTERVAL       10
+#endif
+#ifndef EXTRAKEY_POLLING_INTERVAL
+#   define EXTRAKEY_POLLING_INTERVAL    10
+#endif
+#ifndef NKRO_POLLING_INTERVAL
+#   define NKRO_POLLING_INTERVAL        1
+#endif
+#if KEYBOARD_POLLING_INTERVAL < 1 || KEYBOARD_POLLING_INTERVAL > 255 || \
+    MOUSE_POLLING_INTERVAL < 1 || MOUSE_POLLING_INTERVAL > 255 || \
+    EXTRAKEY_POLLING_INTERVAL < 1 || EXTRAKEY_POLLING_INTERVAL > 255 || \
+    NKRO_POLLING_INTERVAL < 1 || NKRO_POLLING_INTERVAL > 255
+# error "USB polling intervals must be between 1 and 255 ms"
+#endif
+
 #define KEYBOARD_EPSIZE             8
 #define MOUSE_EPSIZE                8
 #define EXTRAKEY_EPSIZE             8
@@ -77,7 +77,7 @@
     #include "virtser.h"
 #endif
 
-#if (defined(RGB_MIDI) | defined(RGBLIGHT_ANIMATIONS)) & defined(RGBLIGHT_ENABLE)
+#ifdef RGBLIGHT_ENABLE
     #include "rgblight.h"
 #endif
 
@@ -89,6 +89,8 @@
 	#include "raw_hid.h"
 #endif
 
+#include "loop_stats.h"
+
 uint8_t keyboard_idle = 0;
 /* 0: Boot Protocol, 1: Report Protocol(default) */
 uint8_t keyboard_protocol = 1;
@@ -251,7 +253,7 @@ static void raw_hid_task(void)
 		// Finalize the stream transfer to receive the last packet
 		Endpoint_ClearOUT();
 
-		if ( data_read )
+		if ( data_read && !loop_stats_raw_hid( data, sizeof(data) ) )
 		{
 			raw_hid_receive( data, sizeof(data) );
 		}
@@ -262,13 +264,48 @@ static void raw_hid_task(void)
 /*******************************************************************************
  * Console
  ******************************************************************************/
+/* sendchar() only appends to this ring and Console_Task() sends it from the
+ * start of frame interrupt, a full packet at a time. A partial packet goes out
+ * once it has waited CONSOLE_FLUSH_FRAMES. When the ring is full sendchar()
+ * waits up to CONSOLE_SEND_TIMEOUT ms for the host to make room, except in an
+ * interrupt where the start of frame can't come and the character is dropped.
+ * Once a wait timed out it doesn't wait again until there is room, so a host
+ * that isn't listening doesn't slow every print down. */
 #ifdef CONSOLE_ENABLE
+#ifndef CONSOLE_BUFFER_SIZE
+#define CONSOLE_BUFFER_SIZE 128
+#endif
+#ifndef CONSOLE_FLUSH_FRAMES
+#define CONSOLE_FLUSH_FRAMES 10
+#endif
+#ifndef CONSOLE_SEND_TIMEOUT
+#define CONSOLE_SEND_TIMEOUT 5
+#endif
+#if CONSOLE_BUFFER_SIZE > 255
+#error "CONSOLE_BUFFER_SIZE must be 255 or less"
+#endif
+
+static uint8_t console_buffer[CONSOLE_BUFFER_SIZE];
+static uint8_t console_head = 0;
+static volatile uint8_t console_count = 0;
+static uint8_t console_wait = 0;
+
+/* characters lost to a full buffer */
+uint16_t console_drops = 0;
+
 static void Console_Task(void)
 {
     /* Device must be connected and configured for the task to run */
     if (USB_DeviceState != DEVICE_STATE_Configured)
         return;
 
+    if (!console_count) {
+        console_wait = 0;
+        return;
+    }
+    if (console_count < CONSOLE_EPSIZE && ++console_wait < CONSOLE_FLUSH_FRAMES)
+        return;
+
     uint8_t ep = Endpoint_GetCurrentEndpoint();
 
 #if 0
@@ -303,13 +340,20 @@ static void Console_Task(void)
         return;
     }
 
-    // fill empty bank
-    while (Endpoint_IsReadWriteAllowed())
-        Endpoint_Write_8(0);
-
-    // flash senchar packet
-    if (Endpoint_IsINReady()) {
+    // one packet per frame, once the host has read the last one
+    if (Endpoint_IsReadWriteAllowed()) {
+        uint8_t n = console_count < CONSOLE_EPSIZE ? console_count : CONSOLE_EPSIZE;
+        for (uint8_t i = 0; i < CONSOLE_EPSIZE; i++) {
+            if (i < n) {
+                Endpoint_Write_8(console_buffer[console_head]);
+                console_head = (console_head + 1) % CONSOLE_BUFFER_SIZE;
+            } else {
+                Endpoint_Write_8(0);
+            }
+        }
         Endpoint_ClearIN();
+        console_count -= n;
+        console_wait = 0;
     }
 
     Endpoint_SelectEndpoint(ep);
@@ -352,9 +396,12 @@ void EVENT_USB_Device_Disconnect(void)
 */
 }
 
+static void report_queues_reset(void);
+
 void EVENT_USB_Device_Reset(void)
 {
     print("[R]");
+    report_queues_reset();
 }
 
 void EVENT_USB_Device_Suspend()
@@ -379,27 +426,29 @@ void EVENT_USB_Device_WakeUp()
 
 
 
-#ifdef CONSOLE_ENABLE
-static bool console_flush = false;
-#define CONSOLE_FLUSH_SET(b)   do { \
-  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {\
-    console_flush = b; \
-  } \
-} while (0)
+static void keyboard_queue_flush(void);
+#ifdef MOUSE_ENABLE
+static void mouse_queue_flush(void);
+#endif
+#ifdef EXTRAKEY_ENABLE
+static void extra_queue_flush(void);
+#endif
 
 // called every 1ms
 void EVENT_USB_Device_StartOfFrame(void)
 {
-    static uint8_t count;
-    if (++count % 50) return;
-    count = 0;
+    keyboard_queue_flush();
+#ifdef MOUSE_ENABLE
+    mouse_queue_flush();
+#endif
+#ifdef EXTRAKEY_ENABLE
+    extra_queue_flush();
+#endif
 
-    if (!console_flush) return;
+#ifdef CONSOLE_ENABLE
     Console_Task();
-    console_flush = false;
-}
-
 #endif
+}
 
 /** Event handler for the USB_ConfigurationChanged event.
  * This is fired when the host sets the current configuration of the USB device after enumeration.
@@ -411,6 +460,9 @@ void EVENT_USB_Device_ConfigurationChanged(void)
 {
     bool ConfigSuccess = true;
 
+    /* reports queued for the old configuration are stale */
+    report_queues_reset();
+
     /* Setup Keyboard HID Report Endpoints */
     ConfigSuccess &= ENDPOINT_CONFIG(KEYBOARD_IN_EPNUM, EP_TYPE_INTERRUPT, ENDPOINT_DIR_IN,
                                      KEYBOARD_EPSIZE, ENDPOINT_BANK_SINGLE);
@@ -596,9 +648,307 @@ static uint8_t keyboard_leds(void)
     return keyboard_led_stats;
 }
 
+/*******************************************************************************
+ * Keyboard report queue
+ *
+ * Reports wait here until the keyboard endpoint bank is free, instead of
+ * send_keyboard() spinning for the host to poll. The queue is flushed right
+ * away and on every start of frame.
+ ******************************************************************************/
+#ifndef KEYBOARD_QUEUE_SIZE
+#define KEYBOARD_QUEUE_SIZE 4
+#endif
+
+typedef struct {
+    report_keyboard_t report;
+    bool nkro;
+    uint16_t frame;
+} keyboard_queue_entry_t;
+
+static keyboard_queue_entry_t keyboard_queue[KEYBOARD_QUEUE_SIZE];
+static uint8_t keyboard_queue_head = 0;
+static volatile uint8_t keyboard_queue_count = 0;
+
+/* reports that found the endpoint busy / that were lost in a full queue */
+uint16_t keyboard_queue_waits = 0;
+uint16_t keyboard_queue_drops = 0;
+
+/* frames from queueing a report to the host reading it, see usb_latency_test() */
+static volatile bool keyboard_inflight = false;
+static uint8_t keyboard_inflight_ep;
+static uint16_t keyboard_inflight_frame;
+static uint16_t keyboard_latency_count;
+static uint16_t keyboard_latency_min;
+static uint16_t keyboard_latency_max;
+static uint32_t keyboard_latency_sum;
+
+#define KEYBOARD_QUEUE_AT(i) (&keyboard_queue[(keyboard_queue_head + (i)) % KEYBOARD_QUEUE_SIZE])
+
+static void keyboard_queue_add(report_keyboard_t *report, bool nkro)
+{
+    /* nobody to send to, the host asks for the state once configured */
+    if (USB_DeviceState != DEVICE_STATE_Configured) return;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (keyboard_queue_count) {
+            keyboard_queue_entry_t *tail = KEYBOARD_QUEUE_AT(keyboard_queue_count - 1);
+            report_keyboard_t *before = keyboard_queue_count > 1 ?
+                &KEYBOARD_QUEUE_AT(keyboard_queue_count - 2)->report : &keyboard_report_sent;
+
+            /* the fresher report replaces the queued one if the host still
+             * sees every edge */
+            if (tail->nkro == nkro && host_keyboard_mergeable(before, &tail->report, report)) {
+                tail->report = *report;
+                return;
+            }
+            if (keyboard_queue_count == KEYBOARD_QUEUE_SIZE) {
+                keyboard_queue_drops++;
+                if (tail->nkro == nkro) {
+                    tail->report = *report;
+                    return;
+                }
+                keyboard_queue_head = (keyboard_queue_head + 1) % KEYBOARD_QUEUE_SIZE;
+                keyboard_queue_count--;
+            }
+        }
+        keyboard_queue_entry_t *entry = KEYBOARD_QUEUE_AT(keyboard_queue_count);
+        entry->report = *report;
+        entry->nkro = nkro;
+        entry->frame = USB_Device_GetFrameNumber();
+        keyboard_queue_count++;
+    }
+}
+
+static void keyboard_latency_done(void)
+{
+    uint16_t frames = (USB_Device_GetFrameNumber() - keyboard_inflight_frame) & 0x7FF;
+    if (!keyboard_latency_count || frames < keyboard_latency_min) keyboard_latency_min = frames;
+    if (frames > keyboard_latency_max) keyboard_latency_max = frames;
+    keyboard_latency_sum += frames;
+    keyboard_latency_count++;
+    keyboard_inflight = false;
+}
+
+static void keyboard_queue_flush(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if ((!keyboard_queue_count && !keyboard_inflight) ||
+            USB_DeviceState != DEVICE_STATE_Configured) return;
+
+        /* may run from the SOF interrupt, leave the endpoint as found */
+        uint8_t ep = Endpoint_GetCurrentEndpoint();
+
+        /* the bank is free again once the host has read the last report */
+        if (keyboard_inflight) {
+            Endpoint_SelectEndpoint(keyboard_inflight_ep);
+            if (Endpoint_IsReadWriteAllowed()) keyboard_latency_done();
+        }
+
+        while (keyboard_queue_count) {
+            keyboard_queue_entry_t *entry = KEYBOARD_QUEUE_AT(0);
+#ifdef NKRO_ENABLE
+            if (entry->nkro) {
+                keyboard_inflight_ep = NKRO_IN_EPNUM;
+                Endpoint_SelectEndpoint(NKRO_IN_EPNUM);
+                if (!Endpoint_IsReadWriteAllowed()) break;
+                Endpoint_Write_Stream_LE(&entry->report, NKRO_EPSIZE, NULL);
+            }
+            else
+#endif
+            {
+                keyboard_inflight_ep = KEYBOARD_IN_EPNUM;
+                Endpoint_SelectEndpoint(KEYBOARD_IN_EPNUM);
+                if (!Endpoint_IsReadWriteAllowed()) break;
+                Endpoint_Write_Stream_LE(&entry->report, KEYBOARD_EPSIZE, NULL);
+            }
+            Endpoint_ClearIN();
+
+            keyboard_inflight = true;
+            keyboard_inflight_frame = entry->frame;
+            keyboard_report_sent = entry->report;
+            keyboard_queue_head = (keyboard_queue_head + 1) % KEYBOARD_QUEUE_SIZE;
+            keyboard_queue_count--;
+        }
+        Endpoint_SelectEndpoint(ep);
+    }
+}
+
+/*******************************************************************************
+ * Mouse and extra key report queues
+ *
+ * Same as the keyboard queue for the mouse and the system/consumer
+ * endpoints. Mouse reports with the same buttons add up their motion while
+ * they wait.
+ ******************************************************************************/
+#ifndef MOUSE_QUEUE_SIZE
+#define MOUSE_QUEUE_SIZE 4
+#endif
+#ifndef EXTRA_QUEUE_SIZE
+#define EXTRA_QUEUE_SIZE 4
+#endif
+
+/* writes a report if the endpoint bank is free, call with interrupts off */
+static bool endpoint_write(uint8_t epnum, const void *data, uint16_t size)
+{
+    uint8_t ep = Endpoint_GetCurrentEndpoint();
+    bool ok = false;
+
+    Endpoint_SelectEndpoint(epnum);
+    if (Endpoint_IsReadWriteAllowed()) {
+        Endpoint_Write_Stream_LE(data, size, NULL);
+        Endpoint_ClearIN();
+        ok = true;
+    }
+    Endpoint_SelectEndpoint(ep);
+    return ok;
+}
+
+#ifdef MOUSE_ENABLE
+static report_mouse_t mouse_queue[MOUSE_QUEUE_SIZE];
+static uint8_t mouse_queue_head = 0;
+static volatile uint8_t mouse_queue_count = 0;
+
+#define MOUSE_QUEUE_AT(i) (&mouse_queue[(mouse_queue_head + (i)) % MOUSE_QUEUE_SIZE])
+
+static bool mouse_add_motion(int8_t *to, int8_t add)
+{
+    int16_t sum = *to + add;
+    if (sum < -127 || sum > 127) return false;
+    *to = sum;
+    return true;
+}
+
+static void mouse_queue_add(report_mouse_t *report)
+{
+    if (USB_DeviceState != DEVICE_STATE_Configured) return;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (mouse_queue_count) {
+            report_mouse_t *tail = MOUSE_QUEUE_AT(mouse_queue_count - 1);
+            report_mouse_t merged = *tail;
+            if (tail->buttons == report->buttons &&
+                mouse_add_motion(&merged.x, report->x) && mouse_add_motion(&merged.y, report->y) &&
+                mouse_add_motion(&merged.v, report->v) && mouse_add_motion(&merged.h, report->h)) {
+                *tail = merged;
+                return;
+            }
+            if (mouse_queue_count == MOUSE_QUEUE_SIZE) {
+                mouse_queue_head = (mouse_queue_head + 1) % MOUSE_QUEUE_SIZE;
+                mouse_queue_count--;
+            }
+        }
+        *MOUSE_QUEUE_AT(mouse_queue_count) = *report;
+        mouse_queue_count++;
+    }
+}
+
+static void mouse_queue_flush(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (USB_DeviceState != DEVICE_STATE_Configured) return;
+        while (mouse_queue_count &&
+               endpoint_write(MOUSE_IN_EPNUM, MOUSE_QUEUE_AT(0), sizeof(report_mouse_t))) {
+            mouse_queue_head = (mouse_queue_head + 1) % MOUSE_QUEUE_SIZE;
+            mouse_queue_count--;
+        }
+    }
+}
+#endif
+
+#ifdef EXTRAKEY_ENABLE
+static report_extra_t extra_queue[EXTRA_QUEUE_SIZE];
+static uint8_t extra_queue_head = 0;
+static volatile uint8_t extra_queue_count = 0;
+
+#define EXTRA_QUEUE_AT(i) (&extra_queue[(extra_queue_head + (i)) % EXTRA_QUEUE_SIZE])
+
+static void extra_queue_add(uint8_t report_id, uint16_t usage)
+{
+    if (USB_DeviceState != DEVICE_STATE_Configured) return;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (extra_queue_count == EXTRA_QUEUE_SIZE) {
+            /* a full queue keeps the latest state of each report */
+            report_extra_t *tail = EXTRA_QUEUE_AT(extra_queue_count - 1);
+            if (tail->report_id == report_id) {
+                tail->usage = usage;
+                return;
+            }
+            extra_queue_head = (extra_queue_head + 1) % EXTRA_QUEUE_SIZE;
+            extra_queue_count--;
+        }
+        report_extra_t *entry = EXTRA_QUEUE_AT(extra_queue_count);
+        entry->report_id = report_id;
+        entry->usage = usage;
+        extra_queue_count++;
+    }
+}
+
+static void extra_queue_flush(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (USB_DeviceState != DEVICE_STATE_Configured) return;
+        while (extra_queue_count &&
+               endpoint_write(EXTRAKEY_IN_EPNUM, EXTRA_QUEUE_AT(0), sizeof(report_extra_t))) {
+            extra_queue_head = (extra_queue_head + 1) % EXTRA_QUEUE_SIZE;
+            extra_queue_count--;
+        }
+    }
+}
+#endif
+
+static void report_queues_reset(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        keyboard_queue_count = 0;
+        keyboard_inflight = false;
+#ifdef MOUSE_ENABLE
+        mouse_queue_count = 0;
+#endif
+#ifdef EXTRAKEY_ENABLE
+        extra_queue_count = 0;
+#endif
+    }
+}
+
+#ifndef USB_LATENCY_TEST_REPORTS
+#define USB_LATENCY_TEST_REPORTS 32
+#endif
+
+/* Sends copies of the last keyboard report, which the host ignores, one at
+ * a time and prints how many frames they waited to be read by the host. */
+void usb_latency_test(void)
+{
+    if (USB_DeviceState != DEVICE_STATE_Configured) return;
+
+    uint8_t interval = KEYBOARD_POLLING_INTERVAL;
+#ifdef NKRO_ENABLE
+    if (keyboard_protocol && keymap_config.nkro) interval = NKRO_POLLING_INTERVAL;
+#endif
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        keyboard_latency_count = 0;
+        keyboard_latency_max = 0;
+        keyboard_latency_sum = 0;
+    }
+
+    report_keyboard_t report = keyboard_report_sent;
+    for (uint8_t i = 0; i < USB_LATENCY_TEST_REPORTS; i++) {
+        send_keyboard(&report);
+        /* give up on a host that stopped polling */
+        for (uint16_t t = 0; t < 1000 && (keyboard_queue_count || keyboard_inflight); t++) {
+            _delay_ms(1);
+        }
+    }
+
+    xprintf("bInterval: %ums\n", interval);
+    xprintf("latency(frames): min %u avg %u max %u in %u reports\n",
+            keyboard_latency_min,
+            keyboard_latency_count ? (uint16_t)(keyboard_latency_sum / keyboard_latency_count) : 0,
+            keyboard_latency_max, keyboard_latency_count);
+}
+
 static void send_keyboard(report_keyboard_t *report)
 {
-    uint8_t timeout = 255;
     uint8_t where = where_to_send();
 
 #ifdef BLUETOOTH_ENABLE
@@ -620,43 +970,20 @@ static void send_keyboard(report_keyboard_t *report)
       return;
     }
 
-    /* Select the Keyboard Report Endpoint */
 #ifdef NKRO_ENABLE
-    if (keyboard_protocol && keymap_config.nkro) {
-        /* Report protocol - NKRO */
-        Endpoint_SelectEndpoint(NKRO_IN_EPNUM);
-
-        /* Check if write ready for a polling interval around 1ms */
-        while (timeout-- && !Endpoint_IsReadWriteAllowed()) _delay_us(4);
-        if (!Endpoint_IsReadWriteAllowed()) return;
-
-        /* Write Keyboard Report Data */
-        Endpoint_Write_Stream_LE(report, NKRO_EPSIZE, NULL);
-    }
-    else
+    keyboard_queue_add(report, keyboard_protocol && keymap_config.nkro);
+#else
+    keyboard_queue_add(report, false);
 #endif
-    {
-        /* Boot protocol */
-        Endpoint_SelectEndpoint(KEYBOARD_IN_EPNUM);
-
-        /* Check if write ready for a polling interval around 10ms */
-        while (timeout-- && !Endpoint_IsReadWriteAllowed()) _delay_us(40);
-        if (!Endpoint_IsReadWriteAllowed()) return;
-
-        /* Write Keyboard Report Data */
-        Endpoint_Write_Stream_LE(report, KEYBOARD_EPSIZE, NULL);
+    keyboard_queue_flush();
+    if (keyboard_queue_count) {
+        keyboard_queue_waits++;
     }
-
-    /* Finalize the stream transfer to send the last packet */
-    Endpoint_ClearIN();
-
-    keyboard_report_sent = *report;
 }
 
 static void send_mouse(report_mouse_t *report)
 {
 #ifdef MOUSE_ENABLE
-    uint8_t timeout = 255;
     uint8_t where = where_to_send();
 
 #ifdef BLUETOOTH_ENABLE
@@ -684,45 +1011,21 @@ static void send_mouse(report_mouse_t *report)
       return;
     }
 
-    /* Select the Mouse Report Endpoint */
-    Endpoint_SelectEndpoint(MOUSE_IN_EPNUM);
-
-    /* Check if write ready for a polling interval around 10ms */
-    while (timeout-- && !Endpoint_IsReadWriteAllowed()) _delay_us(40);
-    if (!Endpoint_IsReadWriteAllowed()) return;
-
-    /* Write Mouse Report Data */
-    Endpoint_Write_Stream_LE(report, sizeof(report_mouse_t), NULL);
-
-    /* Finalize the stream transfer to send the last packet */
-    Endpoint_ClearIN();
+    mouse_queue_add(report);
+    mouse_queue_flush();
 #endif
 }
 
 static void send_system(uint16_t data)
 {
-    uint8_t timeout = 255;
-
-    if (USB_DeviceState != DEVICE_STATE_Configured)
-        return;
-
-    report_extra_t r = {
-        .report_id = REPORT_ID_SYSTEM,
-        .usage = data - SYSTEM_POWER_DOWN + 1
-    };
-    Endpoint_SelectEndpoint(EXTRAKEY_IN_EPNUM);
-
-    /* Check if write ready for a polling interval around 10ms */
-    while (timeout-- && !Endpoint_IsReadWriteAllowed()) _delay_us(40);
-    if (!Endpoint_IsReadWriteAllowed()) return;
-
-    Endpoint_Write_Stream_LE(&r, sizeof(report_extra_t), NULL);
-    Endpoint_ClearIN();
+#ifdef EXTRAKEY_ENABLE
+    extra_queue_add(REPORT_ID_SYSTEM, data - SYSTEM_POWER_DOWN + 1);
+    extra_queue_flush();
+#endif
 }
 
 static void send_consumer(uint16_t data)
 {
-    uint8_t timeout = 255;
     uint8_t where = where_to_send();
 
 #ifdef BLUETOOTH_ENABLE
@@ -753,18 +1056,10 @@ static void send_consumer(uint16_t data)
       return;
     }
 
-    report_extra_t r = {
-        .report_id = REPORT_ID_CONSUMER,
-        .usage = data
-    };
-    Endpoint_SelectEndpoint(EXTRAKEY_IN_EPNUM);
-
-    /* Check if write ready for a polling interval around 10ms */
-    while (timeout-- && !Endpoint_IsReadWriteAllowed()) _delay_us(40);
-    if (!Endpoint_IsReadWriteAllowed()) return;
-
-    Endpoint_Write_Stream_LE(&r, sizeof(report_extra_t), NULL);
-    Endpoint_ClearIN();
+#ifdef EXTRAKEY_ENABLE
+    extra_queue_add(REPORT_ID_CONSUMER, data);
+    extra_queue_flush();
+#endif
 }
 
 
@@ -772,62 +1067,37 @@ static void send_consumer(uint16_t data)
  * sendchar
  ******************************************************************************/
 #ifdef CONSOLE_ENABLE
-#define SEND_TIMEOUT 5
 int8_t sendchar(uint8_t c)
 {
-    // Not wait once timeouted.
-    // Because sendchar() is called so many times, waiting each call causes big lag.
     static bool timeouted = false;
-
-    // prevents Console_Task() from running during sendchar() runs.
-    // or char will be lost. These two function is mutually exclusive.
-    CONSOLE_FLUSH_SET(false);
-
-    if (USB_DeviceState != DEVICE_STATE_Configured)
-        return -1;
-
-    uint8_t ep = Endpoint_GetCurrentEndpoint();
-    Endpoint_SelectEndpoint(CONSOLE_IN_EPNUM);
-    if (!Endpoint_IsEnabled() || !Endpoint_IsConfigured()) {
-        goto ERROR_EXIT;
-    }
-
-    if (timeouted && !Endpoint_IsReadWriteAllowed()) {
-        goto ERROR_EXIT;
-    }
-
-    timeouted = false;
-
-    uint8_t timeout = SEND_TIMEOUT;
-    while (!Endpoint_IsReadWriteAllowed()) {
-        if (USB_DeviceState != DEVICE_STATE_Configured) {
-            goto ERROR_EXIT;
-        }
-        if (Endpoint_IsStalled()) {
-            goto ERROR_EXIT;
-        }
-        if (!(timeout--)) {
-            timeouted = true;
-            goto ERROR_EXIT;
+    int8_t ret = 0;
+
+    if (console_count < CONSOLE_BUFFER_SIZE) {
+        timeouted = false;
+    } else if (!timeouted && (SREG & (1 << SREG_I)) &&
+               USB_DeviceState == DEVICE_STATE_Configured) {
+        // interrupts are on, Console_Task() frees a packet every frame
+        uint16_t timeout = CONSOLE_SEND_TIMEOUT * 10;
+        while (console_count == CONSOLE_BUFFER_SIZE) {
+            if (!timeout--) {
+                timeouted = true;
+                break;
+            }
+            _delay_us(100);
         }
-        _delay_ms(1);
     }
 
-    Endpoint_Write_8(c);
-
-    // send when bank is full
-    if (!Endpoint_IsReadWriteAllowed()) {
-        while (!(Endpoint_IsINReady()));
-        Endpoint_ClearIN();
-    } else {
-        CONSOLE_FLUSH_SET(true);
+    // buffered also before the device is configured, so boot messages get out
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (console_count < CONSOLE_BUFFER_SIZE) {
+            console_buffer[(console_head + console_count) % CONSOLE_BUFFER_SIZE] = c;
+            console_count++;
+        } else {
+            console_drops++;
+            ret = -1;
+        }
     }
-
-    Endpoint_SelectEndpoint(ep);
-    return 0;
-ERROR_EXIT:
-    Endpoint_SelectEndpoint(ep);
-    return -1;
+    return ret;
 }
 #else
 int8_t sendchar(uint8_t c)
@@ -1178,10 +1448,6 @@ int main(void)
         // MIDI_Task();
 #endif
 
-#if defined(RGBLIGHT_ANIMATIONS) & defined(RGBLIGHT_ENABLE)
-        rgblight_task();
-#endif
-
 #ifdef ADAFRUIT_BLE_ENABLE
         adafruit_ble_task();
 #endif
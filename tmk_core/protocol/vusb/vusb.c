@@ -18,9 +18,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <avr/eeprom.h>
 #include <avr/wdt.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include "usbdrv.h"
 #include "usbconfig.h"
 #include "host.h"
+#include "keycode.h"
 #include "report.h"
 #include "print.h"
 #include "debug.h"
@@ -32,11 +34,37 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 static uint8_t vusb_keyboard_leds = 0;
 static uint8_t vusb_idle_rate = 0;
 
-/* Keyboard report send buffer */
-#define KBUF_SIZE 16
-static report_keyboard_t kbuf[KBUF_SIZE];
+/* Keyboard report send buffer
+ *
+ * Holds the key state changes the host hasn't seen yet, modifiers as their
+ * 0xE0-0xE7 key codes. vusb_transfer_keyboard() folds as many of them into
+ * one report as it can without hiding an edge: a key changes at most once
+ * per report and a modifier doesn't change after a key press in the same
+ * report. Changes that don't fit are dropped and the final key state is sent
+ * once the buffer has drained.
+ */
+#ifndef KBUF_SIZE
+#define KBUF_SIZE 32
+#endif
+
+typedef struct {
+    uint8_t code;
+    bool pressed;
+} kbuf_entry_t;
+
+static kbuf_entry_t kbuf[KBUF_SIZE];
 static uint8_t kbuf_head = 0;
 static uint8_t kbuf_tail = 0;
+static bool kbuf_resync = false;
+static report_keyboard_t kbuf_state;    // after all changes in kbuf
+static report_keyboard_t kbuf_sent;     // last one given to the host
+
+/* deepest kbuf has been / reports whose changes didn't fit */
+uint8_t vusb_kbuf_depth_max = 0;
+uint16_t vusb_kbuf_drops = 0;
+
+#define KBUF_COUNT()    ((kbuf_head + KBUF_SIZE - kbuf_tail) % KBUF_SIZE)
+#define KBUF_IS_MOD(c)  ((c) >= KC_LCTRL && (c) <= KC_RGUI)
 
 typedef struct {
         uint8_t modifier;
@@ -46,19 +74,97 @@ typedef struct {
 
 static keyboard_report_t keyboard_report; // sent to PC
 
+static bool kbuf_has_key(const report_keyboard_t *report, uint8_t code)
+{
+    for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+        if (report->keys[i] == code) return true;
+    }
+    return false;
+}
+
+/* queues the changes from old to new, releases first, or only counts them */
+static uint8_t kbuf_changes(const report_keyboard_t *old, const report_keyboard_t *new, bool push)
+{
+    uint8_t n = 0;
+    for (uint8_t pressed = 0; pressed < 2; pressed++) {
+        const report_keyboard_t *from = pressed ? old : new;
+        const report_keyboard_t *to = pressed ? new : old;
+
+        uint8_t mods = to->mods & ~from->mods;
+        for (uint8_t i = 0; i < 8; i++) {
+            if (!(mods & (1 << i))) continue;
+            if (push) kbuf[(kbuf_head + n) % KBUF_SIZE] = (kbuf_entry_t){ KC_LCTRL + i, pressed };
+            n++;
+        }
+        for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+            if (!to->keys[i] || kbuf_has_key(from, to->keys[i])) continue;
+            if (push) kbuf[(kbuf_head + n) % KBUF_SIZE] = (kbuf_entry_t){ to->keys[i], pressed };
+            n++;
+        }
+    }
+    if (push) kbuf_head = (kbuf_head + n) % KBUF_SIZE;
+    return n;
+}
+
+/* false if there is no free slot for a press */
+static bool kbuf_apply(report_keyboard_t *report, const kbuf_entry_t *entry)
+{
+    if (KBUF_IS_MOD(entry->code)) {
+        uint8_t bit = 1 << (entry->code - KC_LCTRL);
+        report->mods = entry->pressed ? (report->mods | bit) : (report->mods & ~bit);
+        return true;
+    }
+    if (entry->pressed && kbuf_has_key(report, entry->code)) return true;
+    for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+        if (entry->pressed && !report->keys[i]) {
+            report->keys[i] = entry->code;
+            return true;
+        }
+        if (!entry->pressed && report->keys[i] == entry->code) report->keys[i] = 0;
+    }
+    return !entry->pressed;
+}
+
+static bool kbuf_touched(uint8_t from, uint8_t to, uint8_t code)
+{
+    for (; from != to; from = (from + 1) % KBUF_SIZE) {
+        if (kbuf[from].code == code) return true;
+    }
+    return false;
+}
+
 /* transfer keyboard report from buffer */
 void vusb_transfer_keyboard(void)
 {
-    if (usbInterruptIsReady()) {
-        if (kbuf_head != kbuf_tail) {
-            usbSetInterrupt((void *)&kbuf[kbuf_tail], sizeof(report_keyboard_t));
-            kbuf_tail = (kbuf_tail + 1) % KBUF_SIZE;
-            if (debug_keyboard) {
-                print("V-USB: kbuf["); pdec(kbuf_tail); print("->"); pdec(kbuf_head); print("](");
-                phex((kbuf_head < kbuf_tail) ? (KBUF_SIZE - kbuf_tail + kbuf_head) : (kbuf_head - kbuf_tail));
-                print(")\n");
-            }
+    if (!usbInterruptIsReady()) return;
+
+    report_keyboard_t report = kbuf_sent;
+    uint8_t first = kbuf_tail;
+    bool key_pressed = false;
+    while (kbuf_tail != kbuf_head) {
+        kbuf_entry_t *entry = &kbuf[kbuf_tail];
+        if (kbuf_touched(first, kbuf_tail, entry->code)) break;
+        if (KBUF_IS_MOD(entry->code) && key_pressed) break;
+        if (kbuf_apply(&report, entry)) {
+            if (entry->pressed && !KBUF_IS_MOD(entry->code)) key_pressed = true;
+        } else if (kbuf_tail != first) {
+            break;
         }
+        kbuf_tail = (kbuf_tail + 1) % KBUF_SIZE;
+    }
+
+    if (first == kbuf_tail) {
+        if (!kbuf_resync) return;
+        kbuf_resync = false;
+        report = kbuf_state;
+    }
+
+    usbSetInterrupt((void *)&report, sizeof(report_keyboard_t));
+    kbuf_sent = report;
+    if (debug_keyboard) {
+        print("V-USB: kbuf["); pdec(kbuf_tail); print("->"); pdec(kbuf_head); print("](");
+        phex(KBUF_COUNT());
+        print(")\n");
     }
 }
 
@@ -91,13 +197,16 @@ static uint8_t keyboard_leds(void) {
 
 static void send_keyboard(report_keyboard_t *report)
 {
-    uint8_t next = (kbuf_head + 1) % KBUF_SIZE;
-    if (next != kbuf_tail) {
-        kbuf[kbuf_head] = *report;
-        kbuf_head = next;
+    uint8_t n = kbuf_changes(&kbuf_state, report, false);
+    if (n < KBUF_SIZE - KBUF_COUNT()) {
+        kbuf_changes(&kbuf_state, report, true);
+        if (KBUF_COUNT() > vusb_kbuf_depth_max) vusb_kbuf_depth_max = KBUF_COUNT();
     } else {
+        vusb_kbuf_drops++;
+        kbuf_resync = true;
         debug("kbuf: full\n");
     }
+    kbuf_state = *report;
 
     // NOTE: send key strokes of Macro
     usbPoll();
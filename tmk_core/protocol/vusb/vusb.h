@@ -24,4 +24,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 host_driver_t *vusb_driver(void);
 void vusb_transfer_keyboard(void);
 
+/* keyboard send buffer stats */
+extern uint8_t vusb_kbuf_depth_max;
+extern uint16_t vusb_kbuf_drops;
+
 #endif
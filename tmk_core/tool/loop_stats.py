@@ -0,0 +1,48 @@
+#!/usr/bin/env python3
+#
+# Queries the scan rate and loop load counters of a keyboard built with
+# LOOP_STATS_ENABLE and RAW_ENABLE, through its raw HID interface.
+#
+# Usage: loop_stats.py /dev/hidrawN [interval]
+#
+# Prints one line per query, every interval seconds if one is given. Linux
+# only, it talks to the hidraw device directly.
+
+import struct
+import sys
+import time
+
+RAW_EPSIZE = 32
+LOOP_STATS_RAW_HID_ID = 0xF5
+TASKS = ('rgblight', 'backlight', 'mousekey', 'visualizer', 'serial_link')
+# loop_stats_t: scans, loops, loop_max_us, task_us[]
+LOOP_STATS = struct.Struct('<HHI%dI' % len(TASKS))
+
+
+def query(device):
+    # report id 0, then the query
+    device.write(bytes([0, LOOP_STATS_RAW_HID_ID]) + bytes(RAW_EPSIZE - 1))
+    while True:
+        reply = device.read(RAW_EPSIZE)
+        if reply[0] == LOOP_STATS_RAW_HID_ID:
+            return LOOP_STATS.unpack_from(reply, 1)
+
+
+def main(argv):
+    if len(argv) not in (2, 3):
+        sys.stderr.write('usage: %s /dev/hidrawN [interval]\n' % argv[0])
+        return 1
+
+    interval = float(argv[2]) if len(argv) == 3 else None
+    print('scans loops max_us ' + ' '.join(t + '_us' for t in TASKS))
+    with open(argv[1], 'r+b', buffering=0) as device:
+        while True:
+            print(' '.join(str(v) for v in query(device)))
+            sys.stdout.flush()
+            if interval is None:
+                return 0
+            time.sleep(interval)
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
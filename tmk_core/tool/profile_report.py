@@ -0,0 +1,131 @@
+#!/usr/bin/env python3
+#
+# Turns the "#P" lines that the profile command prints to the console into
+# a flat profile, with the symbols from the .map file of the same build.
+#
+# Usage: profile_report.py keyboard.map console.log
+#        hid_listen | profile_report.py keyboard.map
+#
+# A bucket usually covers more than one function, its samples are shared out
+# by how many of its bytes each function takes. The last profile in the log
+# is used.
+
+import re
+import sys
+
+HEADER_RE = re.compile(r'#P base ([0-9A-Fa-f]+) shift (\d+) samples (\d+) other (\d+)')
+BUCKET_RE = re.compile(r'#P ([0-9A-Fa-f]+) (\d+)\s*$')
+
+# " .text.name  0xaddr  0xsize  file.o", the section name may be on a line of its own
+SECTION_RE = re.compile(r'^ \.text\.(\S+)(?:\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+\S+)?\s*$')
+SECTION_CONT_RE = re.compile(r'^\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+\S+\s*$')
+# "  0xaddr  name", a global symbol
+SYMBOL_RE = re.compile(r'^\s+0x([0-9a-f]+)\s+([A-Za-z_][\w.$]*)\s*$')
+
+
+def read_map(path):
+    """Returns sorted (start, end, name) ranges of the functions in the map."""
+    ranges = {}
+    pending = None
+    with open(path) as f:
+        for line in f:
+            if pending:
+                match = SECTION_CONT_RE.match(line)
+                if match:
+                    start, size = int(match.group(1), 16), int(match.group(2), 16)
+                    if size:
+                        ranges.setdefault(start, [start + size, pending])
+                pending = None
+                continue
+
+            match = SECTION_RE.match(line)
+            if match:
+                if match.group(2):
+                    start, size = int(match.group(2), 16), int(match.group(3), 16)
+                    if size:
+                        ranges.setdefault(start, [start + size, match.group(1)])
+                else:
+                    pending = match.group(1)
+                continue
+
+            match = SYMBOL_RE.match(line)
+            if match:
+                start = int(match.group(1), 16)
+                if start in ranges:
+                    ranges[start][1] = match.group(2)
+                else:
+                    ranges[start] = [None, match.group(2)]
+
+    if not ranges:
+        raise ValueError('no symbols found in %s' % path)
+
+    # a symbol without a section runs up to the next one
+    starts = sorted(ranges)
+    result = []
+    for i, start in enumerate(starts):
+        end, name = ranges[start]
+        if end is None:
+            end = starts[i + 1] if i + 1 < len(starts) else start + 1
+        result.append((start, end, name))
+    return result
+
+
+def read_profile(lines):
+    profile = None
+    for line in lines:
+        match = HEADER_RE.search(line)
+        if match:
+            profile = {
+                'base': int(match.group(1), 16),
+                'shift': int(match.group(2)),
+                'samples': int(match.group(3)),
+                'other': int(match.group(4)),
+                'buckets': {},
+            }
+            continue
+        match = BUCKET_RE.search(line)
+        if match and profile is not None:
+            profile['buckets'][int(match.group(1), 16)] = int(match.group(2))
+    if profile is None:
+        raise ValueError('no profile ("#P base ...") in the console output')
+    return profile
+
+
+def flat_profile(symbols, profile):
+    size = 1 << profile['shift']
+    counts = {}
+    for address, samples in profile['buckets'].items():
+        end = address + size
+        overlaps = [(min(end, s_end) - max(address, s_start), name)
+                    for s_start, s_end, name in symbols
+                    if s_start < end and s_end > address]
+        covered = sum(o for o, _ in overlaps)
+        if not covered:
+            counts['?0x%X' % address] = counts.get('?0x%X' % address, 0) + samples
+            continue
+        for overlap, name in overlaps:
+            counts[name] = counts.get(name, 0) + samples * overlap / covered
+    return counts
+
+
+def main(argv):
+    if len(argv) not in (2, 3):
+        sys.stderr.write('usage: %s keyboard.map [console.log]\n' % argv[0])
+        return 1
+
+    symbols = read_map(argv[1])
+    log = open(argv[2]) if len(argv) == 3 else sys.stdin
+    profile = read_profile(log)
+    counts = flat_profile(symbols, profile)
+
+    total = profile['samples'] or 1
+    print('%d samples, %d outside the profiled range' % (profile['samples'], profile['other']))
+    print('')
+    print('    %   samples  function')
+    for name, samples in sorted(counts.items(), key=lambda item: -item[1]):
+        print('%5.1f %9.1f  %s' % (100.0 * samples / total, samples, name))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
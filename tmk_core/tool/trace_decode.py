@@ -0,0 +1,103 @@
+#!/usr/bin/env python3
+#
+# Turns the "#T" records that trace_task() prints to the console back into
+# text, with the format strings from the .trace_fmt section of the firmware.
+#
+# Usage: hid_listen | trace_decode.py keyboard.elf
+#        trace_decode.py keyboard.elf console.log
+#
+# Lines that aren't trace records are passed through. The .elf has to be the
+# one the keyboard runs, the record ids are offsets into its .trace_fmt.
+
+import re
+import struct
+import sys
+
+RECORD_RE = re.compile(r'#T([0-9A-Fa-f]+)')
+CONVERSION_RE = re.compile(r'%([-+ #0]*\d*(?:\.\d+)?)l?([diuxXoc%])')
+
+
+def read_section(path, name):
+    with open(path, 'rb') as f:
+        elf = f.read()
+
+    if elf[:4] != b'\x7fELF' or elf[4] != 1:
+        raise ValueError('%s is not a 32 bit ELF file' % path)
+    endian = '<' if elf[5] == 1 else '>'
+
+    shoff, = struct.unpack_from(endian + 'I', elf, 0x20)
+    shentsize, shnum, shstrndx = struct.unpack_from(endian + 'HHH', elf, 0x2E)
+
+    def header(i):
+        # name, type, flags, addr, offset, size
+        return struct.unpack_from(endian + 'IIIIII', elf, shoff + i * shentsize)
+
+    strtab = header(shstrndx)
+    for i in range(shnum):
+        sh_name, _, _, addr, offset, size = header(i)
+        start = strtab[4] + sh_name
+        if elf[start:elf.index(b'\0', start)].decode() == name:
+            return addr, elf[offset:offset + size]
+    raise ValueError('no %s section in %s, was it built with TRACE_ENABLE = yes?' % (name, path))
+
+
+def format_record(formats, record):
+    if len(record) < 5:
+        return '<short trace record>'
+    fmt_id, time, argc = struct.unpack_from('<HHB', record)
+    args = struct.unpack_from('<%dH' % argc, record, 5) if len(record) >= 5 + 2 * argc else ()
+
+    fmt = formats.get(fmt_id)
+    if fmt is None:
+        return '%5u <unknown trace id %04X> %s' % (time, fmt_id, ' '.join('%04X' % a for a in args))
+
+    values = iter(args)
+
+    def convert(match):
+        flags, conversion = match.groups()
+        if conversion == '%':
+            return '%'
+        value = next(values, 0)
+        if conversion in 'di':
+            value = value - 0x10000 if value & 0x8000 else value
+            conversion = 'd'
+        elif conversion == 'u':
+            conversion = 'd'
+        elif conversion == 'c':
+            value = chr(value & 0xFF)
+        return ('%' + flags + conversion) % value
+
+    return '%5u %s' % (time, CONVERSION_RE.sub(convert, fmt))
+
+
+def load_formats(path):
+    addr, data = read_section(path, '.trace_fmt')
+    formats = {}
+    start = 0
+    while start < len(data):
+        end = data.find(b'\0', start)
+        if end < 0:
+            end = len(data)
+        if end > start:
+            formats[(addr + start) & 0xFFFF] = data[start:end].decode('ascii', 'replace')
+        start = end + 1
+    return formats
+
+
+def main(argv):
+    if len(argv) not in (2, 3):
+        sys.stderr.write('usage: %s keyboard.elf [console.log]\n' % argv[0])
+        return 1
+
+    formats = load_formats(argv[1])
+    log = open(argv[2]) if len(argv) == 3 else sys.stdin
+    for line in log:
+        match = RECORD_RE.search(line)
+        if match:
+            line = format_record(formats, bytes.fromhex(match.group(1))) + '\n'
+        sys.stdout.write(line)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))